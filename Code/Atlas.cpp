@@ -0,0 +1,233 @@
+// Atlas.cpp
+
+#include "Atlas.h"
+#include <string.h>
+
+using namespace FontSys;
+
+// Images are kept apart by this many texels of transparent black.  Under linear filtering,
+// this gives each glyph the same edge behavior that a clamped texture of its own used to have.
+static const GLuint ATLAS_PADDING = 1;
+
+// Pages are single-channel.
+static const GLuint ATLAS_BYTES_PER_TEXEL = 1;
+
+// This is the size of the solid block reserved in the corner of each page.
+static const GLuint ATLAS_SOLID_SIZE = 4;
+
+// Atlases are made on the drawing thread and, for fonts prepared in the background, on the loader's thread too,
+// so numbers are handed out atomically.
+#if defined FONTSYS_THREADS
+std::atomic< unsigned int > Atlas::lastSerial( 0 );
+#else
+unsigned int Atlas::lastSerial = 0;
+#endif
+
+Atlas::Atlas( GLuint pageSize /*= 1024*/ )
+{
+	this->pageSize = pageSize;
+#if defined FONTSYS_THREADS
+	serial = lastSerial.fetch_add( 1 ) + 1;
+#else
+	serial = ++lastSerial;
+#endif
+}
+
+/*virtual*/ Atlas::~Atlas( void )
+{
+	Finalize();
+}
+
+bool Atlas::Finalize( void )
+{
+	for( unsigned int i = 0; i < pageArray.size(); i++ )
+	{
+		Page& page = pageArray[i];
+		if( page.texture != 0 )
+			glDeleteTextures( 1, &page.texture );
+	}
+
+	pageArray.clear();
+
+	return true;
+}
+
+bool Atlas::Insert( const GLubyte* image, GLuint width, GLuint height, GLint pitch, Region& region )
+{
+	bool success = false;
+
+	do
+	{
+		if( width + 2 * ATLAS_PADDING > pageSize || height + 2 * ATLAS_PADDING > pageSize )
+			break;
+
+		GLuint x = 0, y = 0;
+		int i;
+
+		// Filling the earliest pages first keeps most strings on a single texture.
+		for( i = 0; i < int( pageArray.size() ); i++ )
+			if( FindSpace( pageArray[i], width, height, x, y ) )
+				break;
+
+		if( i == int( pageArray.size() ) )
+		{
+			if( !AddPage() )
+				break;
+
+			if( !FindSpace( pageArray[i], width, height, x, y ) )
+				break;
+		}
+
+		Page& page = pageArray[i];
+
+		// We have to flip the image for OpenGL.
+		textureBuffer.resize( width * height );
+		for( GLuint row = 0; row < height; row++ )
+		{
+			const GLubyte* scanLine = image + GLint( height - row - 1 ) * pitch;
+			memcpy( &textureBuffer[ row * width ], scanLine, width );
+		}
+
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glBindTexture( GL_TEXTURE_2D, page.texture );
+		glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, width, height, GL_ALPHA, GL_UNSIGNED_BYTE, &textureBuffer[0] );
+
+		region.page = i;
+		region.s0 = GLfloat( x ) / GLfloat( pageSize );
+		region.t0 = GLfloat( y ) / GLfloat( pageSize );
+		region.s1 = GLfloat( x + width ) / GLfloat( pageSize );
+		region.t1 = GLfloat( y + height ) / GLfloat( pageSize );
+
+		success = true;
+	}
+	while( false );
+
+	return success;
+}
+
+void Atlas::GetSolidRegion( int page, Region& region )
+{
+	// Sample the middle of the block so that filtering never reaches the padding.
+	GLfloat s = GLfloat( ATLAS_PADDING + ATLAS_SOLID_SIZE / 2 ) / GLfloat( pageSize );
+
+	region.page = page;
+	region.s0 = s;
+	region.t0 = s;
+	region.s1 = s;
+	region.t1 = s;
+}
+
+bool Atlas::AddFirstPage( void )
+{
+	if( pageArray.size() > 0 )
+		return true;
+
+	return AddPage();
+}
+
+bool Atlas::AddPage( void )
+{
+	bool success = false;
+	Page page;
+	page.texture = 0;
+
+	do
+	{
+		if( pageArray.size() == 0 )
+		{
+			GLint maxTextureSize = 0;
+			glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
+			if( maxTextureSize > 0 && GLuint( maxTextureSize ) < pageSize )
+				pageSize = maxTextureSize;
+		}
+
+		glGenTextures( 1, &page.texture );
+		if( page.texture == 0 )
+			break;
+
+		glBindTexture( GL_TEXTURE_2D, page.texture );
+
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+
+		// Coverage is all we store.  Under the GL_BLEND texture environment that we draw with, an alpha
+		// texture produces the same result that an RGBA texture with coverage in every channel would.
+		textureBuffer.assign( pageSize * pageSize, 0 );
+
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA8, pageSize, pageSize, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &textureBuffer[0] );
+
+		textureBuffer.assign( ATLAS_SOLID_SIZE * ATLAS_SOLID_SIZE, 255 );
+		glTexSubImage2D( GL_TEXTURE_2D, 0, ATLAS_PADDING, ATLAS_PADDING, ATLAS_SOLID_SIZE, ATLAS_SOLID_SIZE, GL_ALPHA, GL_UNSIGNED_BYTE, &textureBuffer[0] );
+
+		// The solid block sits on the first shelf of the page.
+		Shelf shelf;
+		shelf.y = ATLAS_PADDING;
+		shelf.height = ATLAS_SOLID_SIZE;
+		shelf.x = ATLAS_PADDING + ATLAS_SOLID_SIZE + ATLAS_PADDING;
+		page.shelfArray.push_back( shelf );
+
+		pageArray.push_back( page );
+		page.texture = 0;
+
+		// Don't hang on to a page-sized buffer.
+		std::vector< GLubyte >().swap( textureBuffer );
+
+		success = true;
+	}
+	while( false );
+
+	if( page.texture != 0 )
+		glDeleteTextures( 1, &page.texture );
+
+	return success;
+}
+
+size_t Atlas::GetTextureByteCount( void )
+{
+	return pageArray.size() * pageSize * pageSize * ATLAS_BYTES_PER_TEXEL;
+}
+
+bool Atlas::FindSpace( Page& page, GLuint width, GLuint height, GLuint& x, GLuint& y )
+{
+	// Prefer the shelf that wastes the least height.
+	Shelf* bestShelf = nullptr;
+
+	for( unsigned int i = 0; i < page.shelfArray.size(); i++ )
+	{
+		Shelf& shelf = page.shelfArray[i];
+		if( shelf.height < height || shelf.x + width + ATLAS_PADDING > pageSize )
+			continue;
+
+		if( !bestShelf || shelf.height < bestShelf->height )
+			bestShelf = &shelf;
+	}
+
+	// Failing that, open a new shelf on top of the last one.
+	if( !bestShelf )
+	{
+		const Shelf& topShelf = page.shelfArray.back();
+
+		Shelf shelf;
+		shelf.y = topShelf.y + topShelf.height + ATLAS_PADDING;
+		shelf.height = height;
+		shelf.x = ATLAS_PADDING;
+
+		if( shelf.y + shelf.height + ATLAS_PADDING > pageSize )
+			return false;
+
+		page.shelfArray.push_back( shelf );
+		bestShelf = &page.shelfArray.back();
+	}
+
+	x = bestShelf->x;
+	y = bestShelf->y;
+
+	bestShelf->x += width + ATLAS_PADDING;
+
+	return true;
+}
+
+// Atlas.cpp
@@ -0,0 +1,82 @@
+// Atlas.h
+
+#pragma once
+
+#include "FontSystem.h"
+
+// An instance of this class packs glyph images into one or more large texture pages.
+// Glyphs are placed on shelves, left to right; a new shelf is opened beneath the last one
+// when a glyph doesn't fit, and a new page is added when a shelf doesn't fit.
+class FontSys::Atlas
+{
+public:
+
+	Atlas( GLuint pageSize = 1024 );
+	virtual ~Atlas( void );
+
+	bool Finalize( void );
+
+	// This is where an image landed in the atlas.  The texture coordinates
+	// fit the image exactly so that the layout code can rely on tight-fit metrics.
+	struct Region
+	{
+		int page;
+		GLfloat s0, t0;		// Lower-left texture coordinates.
+		GLfloat s1, t1;		// Upper-right texture coordinates.
+	};
+
+	// The given 8-bit coverage image is flipped for OpenGL as it's copied into the atlas.
+	bool Insert( const GLubyte* image, GLuint width, GLuint height, GLint pitch, Region& region );
+
+	// Every page reserves a small solid block so that quads with no glyph image can be drawn without a texture change.
+	void GetSolidRegion( int page, Region& region );
+
+	// Pages are otherwise only added as images are inserted, so a solid quad drawn before any image needs this first.
+	bool AddFirstPage( void );
+
+	int GetPageCount( void ) { return int( pageArray.size() ); }
+	GLuint GetPageTexture( int page ) { return pageArray[ page ].texture; }
+	GLuint GetPageSize( void ) { return pageSize; }
+
+	// This is how much texture memory the pages take up.
+	size_t GetTextureByteCount( void );
+
+	// Every atlas gets a number of its own, never reused, so that vertex data kept against one can tell whether
+	// the atlas it would now be drawn from is the same, and not just another at the same address.
+	unsigned int GetSerial( void ) { return serial; }
+
+private:
+
+	struct Shelf
+	{
+		GLuint y;			// The bottom of the shelf in texels.
+		GLuint height;		// The height of the tallest image on the shelf.
+		GLuint x;			// The next free column on the shelf.
+	};
+
+	typedef std::vector< Shelf > ShelfArray;
+
+	struct Page
+	{
+		GLuint texture;
+		ShelfArray shelfArray;
+	};
+
+	typedef std::vector< Page > PageArray;
+
+	bool AddPage( void );
+	bool FindSpace( Page& page, GLuint width, GLuint height, GLuint& x, GLuint& y );
+
+	PageArray pageArray;
+	GLuint pageSize;
+	std::vector< GLubyte > textureBuffer;
+	unsigned int serial;
+
+#if defined FONTSYS_THREADS
+	static std::atomic< unsigned int > lastSerial;
+#else
+	static unsigned int lastSerial;
+#endif
+};
+
+// Atlas.h
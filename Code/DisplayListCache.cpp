@@ -0,0 +1,23 @@
+// DisplayListCache.cpp
+
+#include "DisplayListCache.h"
+
+using namespace FontSys;
+
+DisplayListCache::DisplayListCache( void )
+{
+}
+
+/*virtual*/ DisplayListCache::~DisplayListCache( void )
+{
+}
+
+/*virtual*/ void DisplayListCache::Discard( GLuint& displayList )
+{
+	if( displayList != 0 )
+		glDeleteLists( displayList, 1 );
+
+	displayList = 0;
+}
+
+// DisplayListCache.cpp
@@ -0,0 +1,21 @@
+// DisplayListCache.h
+
+#pragma once
+
+#include "LruCache.h"
+
+// An instance of this class retains compiled display lists for static text.
+// Lists are deleted as they are evicted, so it must be cleared while the GL context is still current.
+class FontSys::DisplayListCache : public FontSys::LruCache< GLuint >
+{
+public:
+
+	DisplayListCache( void );
+	virtual ~DisplayListCache( void );
+
+protected:
+
+	virtual void Discard( GLuint& displayList ) override;
+};
+
+// DisplayListCache.h
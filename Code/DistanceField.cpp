@@ -0,0 +1,153 @@
+// DistanceField.cpp
+
+#include "DistanceField.h"
+#include <math.h>
+
+using namespace FontSys;
+
+// This stands in for the distance to a feature that doesn't exist.
+static const GLfloat DISTANCE_FIELD_INFINITY = 1e20f;
+
+DistanceField::DistanceField( GLuint scale, GLuint spread )
+{
+	this->scale = scale;
+	this->spread = spread;
+	width = 0;
+	height = 0;
+}
+
+/*virtual*/ DistanceField::~DistanceField( void )
+{
+}
+
+bool DistanceField::Generate( const FT_Bitmap& bitmap )
+{
+	if( bitmap.pixel_mode != FT_PIXEL_MODE_GRAY || !bitmap.buffer )
+		return false;
+
+	GLuint sourceWidth = bitmap.width;
+	GLuint sourceHeight = bitmap.rows;
+	GLuint padding = GetPadding();
+
+	// The grid is the padded source, rounded up so that every texel of the field covers whole pixels.
+	GLuint gridWidth = ( sourceWidth + 2 * padding + scale - 1 ) / scale * scale;
+	GLuint gridHeight = ( sourceHeight + 2 * padding + scale - 1 ) / scale * scale;
+
+	insideGrid.resize( gridWidth * gridHeight );
+	outsideGrid.resize( gridWidth * gridHeight );
+
+	for( GLuint y = 0; y < gridHeight; y++ )
+	{
+		for( GLuint x = 0; x < gridWidth; x++ )
+		{
+			bool inside = false;
+			if( x >= padding && x < padding + sourceWidth && y >= padding && y < padding + sourceHeight )
+				inside = bitmap.buffer[ GLint( y - padding ) * bitmap.pitch + ( x - padding ) ] >= 128;
+
+			insideGrid[ y * gridWidth + x ] = inside ? 0.f : DISTANCE_FIELD_INFINITY;
+			outsideGrid[ y * gridWidth + x ] = inside ? DISTANCE_FIELD_INFINITY : 0.f;
+		}
+	}
+
+	TransformGrid( insideGrid, gridWidth, gridHeight );
+	TransformGrid( outsideGrid, gridWidth, gridHeight );
+
+	width = gridWidth / scale;
+	height = gridHeight / scale;
+	fieldBuffer.resize( width * height );
+
+	// Each texel takes the average signed distance of the pixels it covers.  Pixel centers are half a pixel from the edge.
+	GLfloat range = GLfloat( 2 * padding );
+
+	for( GLuint j = 0; j < height; j++ )
+	{
+		for( GLuint i = 0; i < width; i++ )
+		{
+			GLfloat sum = 0.f;
+
+			for( GLuint y = j * scale; y < ( j + 1 ) * scale; y++ )
+			{
+				for( GLuint x = i * scale; x < ( i + 1 ) * scale; x++ )
+				{
+					GLuint k = y * gridWidth + x;
+					if( insideGrid[k] == 0.f )
+						sum += sqrtf( outsideGrid[k] ) - 0.5f;
+					else
+						sum -= sqrtf( insideGrid[k] ) - 0.5f;
+				}
+			}
+
+			GLfloat value = 0.5f + sum / GLfloat( scale * scale ) / range;
+			if( value < 0.f )
+				value = 0.f;
+			else if( value > 1.f )
+				value = 1.f;
+
+			fieldBuffer[ j * width + i ] = GLubyte( value * 255.f + 0.5f );
+		}
+	}
+
+	return true;
+}
+
+void DistanceField::TransformGrid( std::vector< GLfloat >& grid, GLuint gridWidth, GLuint gridHeight )
+{
+	// The squared distance transform is separable, so columns and then rows give us the exact result.
+	for( GLuint x = 0; x < gridWidth; x++ )
+		Transform( &grid[x], gridHeight, gridWidth );
+
+	for( GLuint y = 0; y < gridHeight; y++ )
+		Transform( &grid[ y * gridWidth ], gridWidth, 1 );
+}
+
+// This is the lower envelope of parabolas method of Felzenszwalb and Huttenlocher.
+void DistanceField::Transform( GLfloat* array, GLuint count, GLuint stride )
+{
+	sampleArray.resize( count );
+	distanceArray.resize( count );
+	parabolaArray.resize( count );
+	boundaryArray.resize( count + 1 );
+
+	for( GLuint q = 0; q < count; q++ )
+		sampleArray[q] = array[ q * stride ];
+
+	int k = 0;
+	parabolaArray[0] = 0;
+	boundaryArray[0] = -DISTANCE_FIELD_INFINITY;
+	boundaryArray[1] = DISTANCE_FIELD_INFINITY;
+
+	for( GLuint q = 1; q < count; q++ )
+	{
+		GLfloat s;
+
+		while( true )
+		{
+			GLuint v = parabolaArray[k];
+			s = ( ( sampleArray[q] + GLfloat( q * q ) ) - ( sampleArray[v] + GLfloat( v * v ) ) ) / GLfloat( 2 * q - 2 * v );
+			if( s > boundaryArray[k] || k == 0 )
+				break;
+
+			k--;
+		}
+
+		k++;
+		parabolaArray[k] = q;
+		boundaryArray[k] = s;
+		boundaryArray[ k + 1 ] = DISTANCE_FIELD_INFINITY;
+	}
+
+	k = 0;
+	for( GLuint q = 0; q < count; q++ )
+	{
+		while( boundaryArray[ k + 1 ] < GLfloat( q ) )
+			k++;
+
+		GLfloat delta = GLfloat( q ) - GLfloat( parabolaArray[k] );
+		distanceArray[q] = delta * delta + sampleArray[ parabolaArray[k] ];
+	}
+
+	for( GLuint q = 0; q < count; q++ )
+		array[ q * stride ] = distanceArray[q];
+}
+
+// DistanceField.cpp
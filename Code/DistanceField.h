@@ -0,0 +1,48 @@
+// DistanceField.h
+
+#pragma once
+
+#include "FontSystem.h"
+
+// An instance of this class turns a high resolution coverage bitmap into a smaller signed distance field.
+// Each texel of the field holds the distance to the nearest glyph edge, mapped so that 0.5 is on the edge,
+// larger values are inside, and the field fades to 0 or 1 at the spread.  The field is padded by the spread
+// on all sides so that the fade fits.  Distances come from an exact Euclidean transform of the source
+// bitmap, so this works with any FreeType, including those without an SDF renderer of their own.
+class FontSys::DistanceField
+{
+public:
+
+	// The source is shrunk by the given scale, and the spread is in texels of the field.
+	DistanceField( GLuint scale, GLuint spread );
+	virtual ~DistanceField( void );
+
+	// The source must be an 8-bit gray bitmap.  Its first row is its top row, and so is the field's.
+	bool Generate( const FT_Bitmap& bitmap );
+
+	GLuint GetWidth( void ) { return width; }
+	GLuint GetHeight( void ) { return height; }
+	const GLubyte* GetBuffer( void ) { return &fieldBuffer[0]; }
+
+	// This is how many source pixels of padding lie to the left of and above the source bitmap in the field.
+	GLuint GetPadding( void ) { return scale * spread; }
+	GLuint GetScale( void ) { return scale; }
+
+private:
+
+	// Square each entry of the given array into its distance to the nearest zero entry, along one dimension.
+	void Transform( GLfloat* array, GLuint count, GLuint stride );
+	void TransformGrid( std::vector< GLfloat >& grid, GLuint gridWidth, GLuint gridHeight );
+
+	GLuint scale;
+	GLuint spread;
+	GLuint width, height;
+	std::vector< GLubyte > fieldBuffer;
+	std::vector< GLfloat > insideGrid, outsideGrid;
+
+	// These are the scratch arrays of the one dimensional transform.
+	std::vector< GLfloat > sampleArray, distanceArray, boundaryArray;
+	std::vector< GLuint > parabolaArray;
+};
+
+// DistanceField.h
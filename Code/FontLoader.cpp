@@ -0,0 +1,118 @@
+// FontLoader.cpp
+
+#include "FontLoader.h"
+
+using namespace FontSys;
+
+FontLoader::FontLoader( System* fontSystem )
+{
+	this->fontSystem = fontSystem;
+
+#if defined FONTSYS_THREADS
+	quit = false;
+	thread = std::thread( &FontLoader::ThreadMain, this );
+#endif
+}
+
+/*virtual*/ FontLoader::~FontLoader( void )
+{
+#if defined FONTSYS_THREADS
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		quit = true;
+	}
+
+	requestCondition.notify_all();
+	thread.join();
+#endif
+
+	// Fonts nobody came for are thrown away.  None of them has touched OpenGL yet.
+	for( LoadList::iterator iter = finishedList.begin(); iter != finishedList.end(); iter++ )
+	{
+		if( iter->font )
+		{
+			iter->font->Finalize();
+			delete iter->font;
+		}
+	}
+}
+
+void FontLoader::Enqueue( const Request& request )
+{
+	Load load;
+	load.request = request;
+	load.font = nullptr;
+
+#if defined FONTSYS_THREADS
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		requestList.push_back( load );
+	}
+
+	requestCondition.notify_one();
+#else
+	load.font = LoadFont( request );
+	finishedList.push_back( load );
+#endif
+}
+
+bool FontLoader::Dequeue( Request& request, Font*& font )
+{
+#if defined FONTSYS_THREADS
+	std::lock_guard< std::mutex > lock( mutex );
+#endif
+
+	if( finishedList.size() == 0 )
+		return false;
+
+	request = finishedList.front().request;
+	font = finishedList.front().font;
+	finishedList.pop_front();
+
+	return true;
+}
+
+Font* FontLoader::LoadFont( const Request& request )
+{
+	Font* font = new Font( fontSystem, request.renderMode );
+
+	if( !font->InitializeFile( request.fontFile ) || !font->PrepareGlyphs( request.charCodeArray, request.pixelHeight ) )
+	{
+		font->Finalize();
+		delete font;
+		font = nullptr;
+	}
+
+	return font;
+}
+
+#if defined FONTSYS_THREADS
+
+void FontLoader::ThreadMain( void )
+{
+	while( true )
+	{
+		Load load;
+
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			while( !quit && requestList.size() == 0 )
+				requestCondition.wait( lock );
+
+			if( quit )
+				break;
+
+			load = requestList.front();
+			requestList.pop_front();
+		}
+
+		load.font = LoadFont( load.request );
+
+		std::lock_guard< std::mutex > lock( mutex );
+		finishedList.push_back( load );
+	}
+}
+
+#endif //FONTSYS_THREADS
+
+// FontLoader.cpp
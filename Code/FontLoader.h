@@ -0,0 +1,61 @@
+// FontLoader.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include "WorkerPool.h"
+#include <list>
+
+// An instance of this class loads fonts on a thread of its own.  Each font is opened, measured and
+// has its requested glyphs rasterized there, so that all that is left for the GL thread is to upload
+// the images.  Fonts are handed back in the order they were asked for.  Without threads, fonts are
+// loaded as they're asked for instead.
+class FontSys::FontLoader
+{
+public:
+
+	FontLoader( System* fontSystem );
+	virtual ~FontLoader( void );
+
+	struct Request
+	{
+		std::string font;
+		std::string fontFile;
+		std::string key;
+		System::RenderMode renderMode;
+		CharCodeArray charCodeArray;
+		GLfloat pixelHeight;
+	};
+
+	void Enqueue( const Request& request );
+
+	// Return false if no font has finished loading.  The font is null if it failed to load.
+	bool Dequeue( Request& request, Font*& font );
+
+private:
+
+	struct Load
+	{
+		Request request;
+		Font* font;
+	};
+
+	typedef std::list< Load > LoadList;
+
+	Font* LoadFont( const Request& request );
+
+	System* fontSystem;
+	LoadList requestList;
+	LoadList finishedList;
+
+#if defined FONTSYS_THREADS
+	void ThreadMain( void );
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable requestCondition;
+	bool quit;
+#endif
+};
+
+// FontLoader.h
@@ -1,16 +1,45 @@
 // FontSystem.cpp
 
 #include "FontSystem.h"
+#include "Atlas.h"
+#include "QuadBatch.h"
+#include "KerningCache.h"
+#include "Utf8Decoder.h"
+#include "LruCache.h"
+#include "LookupTable.h"
+#include "DisplayListCache.h"
+#include "DistanceField.h"
+#include "WorkerPool.h"
+#include "GlyphCacheFile.h"
+#include "FontLoader.h"
+#include "SharedMappedFile.h"
+#include "TextBatch.h"
+#include "RetainedText.h"
 #include FT_MODULE_H
 #include FT_TRUETYPE_IDS_H
+#include FT_TRUETYPE_TABLES_H
+#include FT_SIZES_H
 #include <algorithm>
-#include <locale>
-#include <codecvt>
+#include <unordered_set>
+#include <math.h>
+#if defined FONTSYS_THREADS
+#	include <chrono>
+#endif
 
 // TODO: Find and plug mem-leak.
 
 using namespace FontSys;
 
+// This is a monotonic clock for time budgets.  Where there is no standard clock, there is the Windows tick count.
+static double GetSeconds( void )
+{
+#if defined FONTSYS_THREADS
+	return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#else
+	return double( GetTickCount() ) / 1000.0;
+#endif
+}
+
 System::System( void )
 {
 	initialized = false;
@@ -20,6 +49,16 @@ System::System( void )
 	baseLineDelta = -7.f;
 	justification = JUSTIFY_LEFT;
 	wordWrap = false;
+	renderMode = RENDER_COVERAGE;
+	layoutCacheBudget = 0;
+	retainedTextMaxCount = 1024;
+	retainedTextByteBudget = 16 * 1024 * 1024;
+	workerPool = nullptr;
+	fontLoader = nullptr;
+	uploadingFont = nullptr;
+	textBatch = nullptr;
+	batching = false;
+	publishedFontMap = nullptr;
 }
 
 /*virtual*/ System::~System( void )
@@ -67,6 +106,18 @@ bool System::Finalize( void )
 	
 	do
 	{
+		// The loader's thread has to stop before anything it might be using goes away.
+		delete fontLoader;
+		fontLoader = nullptr;
+		loadingFontKeySet.clear();
+
+		if( uploadingFont )
+		{
+			uploadingFont->Finalize();
+			delete uploadingFont;
+			uploadingFont = nullptr;
+		}
+
 		while( fontMap.size() > 0 )
 		{
 			FontMap::iterator iter = fontMap.begin();
@@ -76,6 +127,21 @@ bool System::Finalize( void )
 			fontMap.erase( iter );
 		}
 
+		publishedFontMap = nullptr;
+
+		for( unsigned int i = 0; i < publishedFontMapArray.size(); i++ )
+			delete publishedFontMapArray[i];
+
+		publishedFontMapArray.clear();
+
+		delete workerPool;
+		workerPool = nullptr;
+
+		// Any batch still open refers to fonts that are gone now.
+		delete textBatch;
+		textBatch = nullptr;
+		batching = false;
+
 		if( initialized )
 		{
 			FT_Error error = FT_Done_Library( library );
@@ -92,6 +158,22 @@ bool System::Finalize( void )
 	return success;
 }
 
+void System::GetLayoutParams( LayoutParams& params )
+{
+	params.lineWidth = lineWidth;
+	params.lineHeight = lineHeight;
+	params.baseLineDelta = baseLineDelta;
+	params.justification = justification;
+	params.wordWrap = wordWrap;
+}
+
+/*static*/ bool System::LayoutParamsMatch( const LayoutParams& paramsA, const LayoutParams& paramsB )
+{
+	return( paramsA.lineWidth == paramsB.lineWidth && paramsA.lineHeight == paramsB.lineHeight &&
+			paramsA.baseLineDelta == paramsB.baseLineDelta && paramsA.justification == paramsB.justification &&
+			paramsA.wordWrap == paramsB.wordWrap );
+}
+
 /*virtual*/ std::string System::ResolveFontPath( const std::string& font )
 {
 	return fontBaseDir + "/" + font;
@@ -111,6 +193,51 @@ bool System::DrawText( GLfloat x, GLfloat y, const std::string& text, bool stati
 	return success;
 }
 
+bool System::BeginBatch( void )
+{
+	if( !initialized || batching )
+		return false;
+
+	if( !textBatch )
+		textBatch = new TextBatch();
+
+	textBatch->Clear();
+	batching = true;
+	return true;
+}
+
+bool System::Flush( void )
+{
+	if( !batching )
+		return false;
+
+	batching = false;
+
+	if( textBatch->IsEmpty() )
+		return true;
+
+	// The vertices are already in eye space.  Drawing with a color array leaves the current color undefined.
+	glPushAttrib( GL_CURRENT_BIT );
+	glMatrixMode( GL_MODELVIEW );
+	glPushMatrix();
+	glLoadIdentity();
+
+	glEnable( GL_TEXTURE_2D );
+	glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+
+	textBatch->Draw();
+
+	glDisable( GL_BLEND );
+	glDisable( GL_ALPHA_TEST );
+	glDisable( GL_TEXTURE_2D );
+
+	glPopMatrix();
+	glPopAttrib();
+
+	textBatch->Clear();
+	return true;
+}
+
 bool System::DrawTextCPtr( const char* text, bool staticText /*= false*/ )
 {
 	std::string str( text );
@@ -163,6 +290,96 @@ bool System::CalcTextLength( const std::string& text, GLfloat& length )
 	return success;
 }
 
+bool System::MeasureText( const std::string& text, TextMetrics& textMetrics )
+{
+	bool success = false;
+
+	do
+	{
+		if( !initialized )
+			break;
+
+		Font* cachedFont = GetOrCreateCachedFont();
+		if( !cachedFont )
+			break;
+
+		if( !cachedFont->MeasureText( text, textMetrics ) )
+			break;
+
+		success = true;
+	}
+	while( false );
+
+	return success;
+}
+
+bool System::CalcTextLength( const std::string& font, GLfloat lineHeight, const std::string& text, GLfloat& length )
+{
+	Font* cachedFont = GetOrCreateCachedFont( font );
+	if( !cachedFont )
+		return false;
+
+	return cachedFont->CalcTextLength( text, lineHeight, length );
+}
+
+bool System::MeasureText( const std::string& font, const LayoutParams& params, const std::string& text, TextMetrics& textMetrics )
+{
+	Font* cachedFont = GetOrCreateCachedFont( font );
+	if( !cachedFont )
+		return false;
+
+	return cachedFont->MeasureText( text, params, textMetrics );
+}
+
+bool System::CalcTextLengths( const std::vector< std::string >& textArray, std::vector< GLfloat >& lengthArray )
+{
+	bool success = false;
+
+	do
+	{
+		if( !initialized )
+			break;
+
+		Font* cachedFont = GetOrCreateCachedFont();
+		if( !cachedFont )
+			break;
+
+		if( !cachedFont->CalcTextLengths( textArray, lineHeight, lengthArray ) )
+			break;
+
+		success = true;
+	}
+	while( false );
+
+	return success;
+}
+
+bool System::MeasureTexts( const std::vector< std::string >& textArray, std::vector< TextMetrics >& textMetricsArray )
+{
+	bool success = false;
+
+	do
+	{
+		if( !initialized )
+			break;
+
+		Font* cachedFont = GetOrCreateCachedFont();
+		if( !cachedFont )
+			break;
+
+		LayoutParams params;
+		GetLayoutParams( params );
+
+		if( !cachedFont->MeasureTexts( textArray, params, textMetricsArray ) )
+			break;
+
+		success = true;
+	}
+	while( false );
+
+	return success;
+}
+
 bool System::DisplayListCached( const std::string& text )
 {
 	if( !initialized )
@@ -175,390 +392,2102 @@ bool System::DisplayListCached( const std::string& text )
 	return cachedFont->DisplayListCached( text );
 }
 
-Font* System::GetOrCreateCachedFont( void )
+size_t System::GetTextureMemoryUsage( FontByteCountMap& fontByteCountMap )
 {
-	Font* cachedFont = nullptr;
-	
-	if( initialized && !font.empty() )
+	size_t totalByteCount = 0;
+
+	fontByteCountMap.clear();
+
+	// Other threads may be adding fonts, so we go by the published map.
+	FontMap* fontMap = GetPublishedFontMap();
+	if( !fontMap )
+		return 0;
+
+	for( FontMap::iterator iter = fontMap->begin(); iter != fontMap->end(); iter++ )
 	{
-		std::string key = MakeFontKey( font );
+		size_t byteCount = iter->second->GetTextureByteCount();
+		fontByteCountMap[ iter->first ] = byteCount;
+		totalByteCount += byteCount;
+	}
 
-		FontMap::iterator iter = fontMap.find( key );
-		if( iter != fontMap.end() )
-			cachedFont = iter->second;
-		else
-		{
-			cachedFont = new Font( this );
+	return totalByteCount;
+}
 
-			if( cachedFont->Initialize( font ) )
-				fontMap[ key ] = cachedFont;
-			else
-			{
-				delete cachedFont;
-				cachedFont = nullptr;
-			}
-		}
+void System::GetStats( Stats& stats, FontStatsMap& fontStatsMap )
+{
+	memset( &stats, 0, sizeof( Stats ) );
+
+	fontStatsMap.clear();
+
+	FontMap* fontMap = GetPublishedFontMap();
+	if( !fontMap )
+		return;
+
+	for( FontMap::iterator iter = fontMap->begin(); iter != fontMap->end(); iter++ )
+	{
+		Stats& fontStats = fontStatsMap[ iter->first ];
+		iter->second->GetStats( fontStats );
+
+		stats.glyphCacheHits += fontStats.glyphCacheHits;
+		stats.glyphCacheMisses += fontStats.glyphCacheMisses;
+		stats.kerningLookups += fontStats.kerningLookups;
+		stats.kerningCacheMisses += fontStats.kerningCacheMisses;
+		stats.glyphsRasterized += fontStats.glyphsRasterized;
+		stats.textureBinds += fontStats.textureBinds;
+		stats.drawCalls += fontStats.drawCalls;
+		stats.displayListCalls += fontStats.displayListCalls;
+		stats.layoutCount += fontStats.layoutCount;
+		stats.layoutSeconds += fontStats.layoutSeconds;
+		stats.displayListCount += fontStats.displayListCount;
+		stats.textureByteCount += fontStats.textureByteCount;
 	}
+}
 
-	return cachedFont;
+void System::ResetStats( void )
+{
+	FontMap* fontMap = GetPublishedFontMap();
+	if( !fontMap )
+		return;
+
+	for( FontMap::iterator iter = fontMap->begin(); iter != fontMap->end(); iter++ )
+		iter->second->ResetStats();
 }
 
-std::string System::MakeFontKey( const std::string& font )
+void System::SetRetainedTextLimits( size_t retainedTextMaxCount, size_t retainedTextByteBudget )
 {
-	std::string key = font;
-	std::transform( key.begin(), key.end(), key.begin(), ::tolower );
-	return key;
+	this->retainedTextMaxCount = retainedTextMaxCount;
+	this->retainedTextByteBudget = retainedTextByteBudget;
 }
 
-/*static*/ std::wstring System::GetWide( const std::string& text )
+bool System::PinStaticText( const std::string& text, bool pinned /*= true*/ )
 {
-#if defined LINUX
-	setlocale( LC_ALL, "" );
-	wchar_t buffer[ 1024 ];
-	mbstowcs( buffer, text.c_str(), sizeof( buffer ) );
-	std::wstring wideText( buffer );
-	return wideText;
-#else
-	std::wstring_convert< std::codecvt_utf8_utf16< wchar_t > > converter;
-	std::wstring wideText = converter.from_bytes( text.c_str() );
-	return wideText;
-#endif
+	if( !initialized )
+		return false;
+
+	Font* cachedFont = GetOrCreateCachedFont();
+	if( !cachedFont )
+		return false;
+
+	return cachedFont->PinStaticText( text, pinned );
 }
 
-Font::Font( System* fontSystem )
+bool System::ReleaseStaticText( const std::string& text )
 {
-	initialized = false;
-	this->fontSystem = fontSystem;
-	lineHeightMetric = 0;
+	if( !initialized )
+		return false;
+
+	Font* cachedFont = GetOrCreateCachedFont();
+	if( !cachedFont )
+		return false;
+
+	return cachedFont->ReleaseStaticText( text );
 }
 
-/*virtual*/ Font::~Font( void )
+RetainedText* System::CreateText( const std::string& text )
 {
-	if( initialized )
-		Finalize();
+	if( !initialized )
+		return nullptr;
+
+	Font* cachedFont = GetOrCreateCachedFont();
+	if( !cachedFont )
+		return nullptr;
+
+	LayoutParams params;
+	GetLayoutParams( params );
+
+	RetainedText* retainedText = new RetainedText( this, cachedFont, params, text );
+	if( !retainedText->Build() )
+	{
+		delete retainedText;
+		retainedText = nullptr;
+	}
+
+	return retainedText;
+}
+
+void System::DestroyText( RetainedText* retainedText )
+{
+	delete retainedText;
+}
+
+bool System::PreloadText( const std::string& text )
+{
+	CharCodeArray charCodeArray;
+
+	Utf8Decoder decoder( text );
+	FT_ULong charCode;
+
+	while( decoder.Next( charCode ) )
+		charCodeArray.push_back( charCode );
+
+	return PreloadGlyphs( charCodeArray );
+}
+
+bool System::PreloadCharRange( FT_ULong firstCharCode, FT_ULong lastCharCode )
+{
+	CharCodeArray charCodeArray;
+
+	for( FT_ULong charCode = firstCharCode; charCode <= lastCharCode && charCode >= firstCharCode; charCode++ )
+		charCodeArray.push_back( charCode );
+
+	return PreloadGlyphs( charCodeArray );
+}
+
+bool System::PreloadGlyphs( const CharCodeArray& charCodeArray )
+{
+	if( !initialized )
+		return false;
+
+	Font* cachedFont = GetOrCreateCachedFont();
+	if( !cachedFont )
+		return false;
+
+	return cachedFont->PreloadGlyphs( charCodeArray );
+}
+
+bool System::BakeGlyphCache( const CharCodeArray& charCodeArray )
+{
+	if( !initialized )
+		return false;
+
+	Font* cachedFont = GetOrCreateCachedFont();
+	if( !cachedFont )
+		return false;
+
+	return cachedFont->BakeGlyphCache( charCodeArray );
+}
+
+WorkerPool* System::GetWorkerPool( void )
+{
+	// The threads aren't started until something has work for them.
+	if( !workerPool )
+		workerPool = new WorkerPool();
+
+	return workerPool;
+}
+
+bool System::LoadFontAsync( const std::string& font, const CharCodeArray& charCodeArray /*= CharCodeArray()*/ )
+{
+	if( !initialized || font.empty() )
+		return false;
+
+	std::string key = MakeFontKey( font );
+	if( FindFont( key ) || loadingFontKeySet.find( key ) != loadingFontKeySet.end() )
+		return true;
+
+	if( !fontLoader )
+		fontLoader = new FontLoader( this );
+
+	// Anything that needs OpenGL, or that the application might override, is done here rather than on the loader's thread.
+	FontLoader::Request request;
+	request.font = font;
+	request.fontFile = ResolveFontPath( font );
+	request.key = key;
+	request.renderMode = renderMode;
+	request.charCodeArray = charCodeArray;
+	request.pixelHeight = Font::CalcPixelHeight( lineHeight );
+
+	if( request.charCodeArray.size() == 0 )
+		for( FT_ULong charCode = 0x20; charCode < 0x7F; charCode++ )
+			request.charCodeArray.push_back( charCode );
+
+	fontLoader->Enqueue( request );
+	loadingFontKeySet.insert( key );
+
+	return true;
+}
+
+void System::PumpFontLoads( GLfloat budgetMilliseconds )
+{
+	if( !fontLoader )
+		return;
+
+	double deadline = GetSeconds() + double( budgetMilliseconds ) / 1000.0;
+
+	do
+	{
+		if( !uploadingFont )
+		{
+			FontLoader::Request request;
+			if( !fontLoader->Dequeue( request, uploadingFont ) )
+				break;
+
+			uploadingFontName = request.font;
+			uploadingFontKey = request.key;
+
+			if( !uploadingFont )
+			{
+				loadingFontKeySet.erase( uploadingFontKey );
+
+				if( fontLoadCallback )
+					fontLoadCallback( uploadingFontName, false );
+
+				continue;
+			}
+		}
+
+		if( uploadingFont->UploadPendingImage() )
+			continue;
+
+		// The font may have been loaded the slow way in the meantime, as a fallback or for measuring, in which case we keep that one.
+		bool published = false;
+
+		{
+#if defined FONTSYS_THREADS
+			std::lock_guard< std::mutex > lock( fontMapMutex );
+#endif
+			if( fontMap.find( uploadingFontKey ) == fontMap.end() )
+			{
+				fontMap[ uploadingFontKey ] = uploadingFont;
+				PublishFontMap();
+				published = true;
+			}
+		}
+
+		if( !published )
+		{
+			uploadingFont->Finalize();
+			delete uploadingFont;
+		}
+
+		uploadingFont = nullptr;
+		loadingFontKeySet.erase( uploadingFontKey );
+
+		if( fontLoadCallback )
+			fontLoadCallback( uploadingFontName, true );
+	}
+	while( GetSeconds() < deadline );
+}
+
+bool System::IsFontReady( const std::string& font )
+{
+	return( FindFont( MakeFontKey( font ) ) ? true : false );
+}
+
+void System::LockLibrary( void )
+{
+#if defined FONTSYS_THREADS
+	libraryMutex.lock();
+#endif
+}
+
+void System::UnlockLibrary( void )
+{
+#if defined FONTSYS_THREADS
+	libraryMutex.unlock();
+#endif
+}
+
+Font* System::GetOrCreateCachedFont( void )
+{
+	// A font that is still loading in the background is stood in for by the fallback font, if there is one.
+	if( loadingFontKeySet.size() > 0 && loadingFontKeySet.find( MakeFontKey( font ) ) != loadingFontKeySet.end() )
+		return fallbackFont.empty() ? nullptr : GetOrCreateCachedFont( fallbackFont );
+
+	return GetOrCreateCachedFont( font );
+}
+
+Font* System::GetOrCreateCachedFont( const std::string& font )
+{
+	Font* cachedFont = nullptr;
+	
+	if( initialized && !font.empty() )
+	{
+		std::string key = MakeFontKey( font );
+
+		cachedFont = FindFont( key );
+		if( cachedFont )
+			return cachedFont;
+
+		// Whoever gets the lock first loads the font; anyone else waiting for it then finds it in the map.
+#if defined FONTSYS_THREADS
+		std::lock_guard< std::mutex > lock( fontMapMutex );
+#endif
+
+		FontMap::iterator iter = fontMap.find( key );
+		if( iter != fontMap.end() )
+			cachedFont = iter->second;
+		else
+		{
+			cachedFont = new Font( this, renderMode );
+
+			if( cachedFont->Initialize( font ) )
+			{
+				fontMap[ key ] = cachedFont;
+				PublishFontMap();
+			}
+			else
+			{
+				delete cachedFont;
+				cachedFont = nullptr;
+			}
+		}
+	}
+
+	return cachedFont;
+}
+
+Font* System::FindFont( const std::string& key )
+{
+	FontMap* fontMap = GetPublishedFontMap();
+	if( !fontMap )
+		return nullptr;
+
+	FontMap::iterator iter = fontMap->find( key );
+	if( iter == fontMap->end() )
+		return nullptr;
+
+	return iter->second;
+}
+
+// This must be called with the font map lock held.
+void System::PublishFontMap( void )
+{
+	FontMap* newFontMap = new FontMap( fontMap );
+	publishedFontMapArray.push_back( newFontMap );
+
+#if defined FONTSYS_THREADS
+	publishedFontMap.store( newFontMap, std::memory_order_release );
+#else
+	publishedFontMap = newFontMap;
+#endif
+}
+
+FontMap* System::GetPublishedFontMap( void )
+{
+#if defined FONTSYS_THREADS
+	return publishedFontMap.load( std::memory_order_acquire );
+#else
+	return publishedFontMap;
+#endif
+}
+
+std::string System::MakeFontKey( const std::string& font )
+{
+	std::string key = font;
+	std::transform( key.begin(), key.end(), key.begin(), ::tolower );
+
+	// Coverage fonts keep the plain name as their key.
+	if( renderMode == RENDER_DISTANCE_FIELD )
+		key += "#sdf";
+
+	return key;
+}
+
+/*static*/ void System::GetWide( const std::string& text, std::wstring& wideText )
+{
+	wideText.clear();
+
+	Utf8Decoder decoder( text );
+	FT_ULong charCode;
+
+	while( decoder.Next( charCode ) )
+	{
+		// Where wide characters are only 16 bits, as on Windows, we have to produce surrogate pairs.
+		if( sizeof( wchar_t ) == 2 && charCode > 0xFFFF )
+		{
+			charCode -= 0x10000;
+			wideText.push_back( wchar_t( 0xD800 + ( charCode >> 10 ) ) );
+			wideText.push_back( wchar_t( 0xDC00 + ( charCode & 0x3FF ) ) );
+		}
+		else
+			wideText.push_back( wchar_t( charCode ) );
+	}
+}
+
+/*static*/ std::wstring System::GetWide( const std::string& text )
+{
+	std::wstring wideText;
+	GetWide( text, wideText );
+	return wideText;
+}
+
+// Layout is always done at this size, whichever strike the text is drawn with, so that its metrics don't depend on the strike.
+static const GLuint LAYOUT_PIXEL_SIZE = 128;
+
+// These are the strikes, in pixels per em, smallest first.  The largest is the layout size.
+static const GLuint STRIKE_PIXEL_SIZE[ STRIKE_COUNT ] = { 16, 24, 32, 48, 64, 96, LAYOUT_PIXEL_SIZE };
+
+// Distance fields are made from glyphs rasterized at the layout size and shrunk by this much, to 32 pixels per em.
+static const GLuint DISTANCE_FIELD_SCALE = 4;
+
+// This is how many texels of the field it takes to fade from an edge to fully inside or outside.
+static const GLuint DISTANCE_FIELD_SPREAD = 4;
+
+// Fewer glyphs than this are preloaded on the calling thread alone.
+static const unsigned int PRELOAD_WORKER_MIN_GLYPHS = 32;
+
+// Kerning is baked for every pair of glyphs, so it is left to FreeType when there are more glyphs than this.
+static const unsigned int BAKE_KERNING_MAX_GLYPHS = 1024;
+
+static void MakeGlyphCacheKey( uint64_t fontHash, GLuint pixelSize, System::RenderMode renderMode, GlyphCacheFile::Key& key )
+{
+	memset( &key, 0, sizeof( GlyphCacheFile::Key ) );
+	key.fontHash = fontHash;
+	key.pixelSize = pixelSize;
+	key.renderMode = renderMode;
+	key.layoutPixelSize = LAYOUT_PIXEL_SIZE;
+
+	if( renderMode == System::RENDER_DISTANCE_FIELD )
+	{
+		key.fieldScale = DISTANCE_FIELD_SCALE;
+		key.fieldSpread = DISTANCE_FIELD_SPREAD;
+	}
+}
+
+Font::Font( System* fontSystem, System::RenderMode renderMode )
+{
+	initialized = false;
+	this->fontSystem = fontSystem;
+	this->renderMode = renderMode;
+	face = nullptr;
+	layoutSize = nullptr;
+	for( int i = 0; i < STRIKE_COUNT; i++ )
+	{
+		strikeArray[i].size = nullptr;
+		strikeArray[i].atlas = nullptr;
+		strikeArray[i].cacheFile = nullptr;
+	}
+	fontHash = 0;
+	fontData = nullptr;
+	metricsCacheFile = nullptr;
+	pendingStrike = 0;
+	pendingIndex = 0;
+	quadBatch = nullptr;
+	distanceField = nullptr;
+	kerningCache = nullptr;
+	glyphTable = nullptr;
+	layoutCache = nullptr;
+	displayListCache = nullptr;
+	lineHeightMetric = 0;
+	memset( &stats, 0, sizeof( System::Stats ) );
+}
+
+/*virtual*/ Font::~Font( void )
+{
+	if( initialized )
+		Finalize();
+}
+
+/*virtual*/ bool Font::Initialize( const std::string& font )
+{
+	return InitializeFile( fontSystem->ResolveFontPath( font ) );
+}
+
+bool Font::InitializeFile( const std::string& fontFile )
+{
+	bool success = false;
+
+	do
+	{
+		if( initialized )
+			break;
+
+		this->fontFile = fontFile;
+
+		// The file is mapped once for the whole process, however many fonts, systems and threads open it.
+		// A file that can't be mapped can still be read the usual way.
+		fontData = SharedMappedFile::Acquire( fontFile );
+
+		FT_Error error;
+
+		fontSystem->LockLibrary();
+		if( fontData )
+			error = FT_New_Memory_Face( fontSystem->GetLibrary(), fontData->GetData(), FT_Long( fontData->GetSize() ), 0, &face );
+		else
+			error = FT_New_Face( fontSystem->GetLibrary(), fontFile.c_str(), 0, &face );
+		fontSystem->UnlockLibrary();
+
+		if( error != FT_Err_Ok || !face )
+			break;
+
+		int i, j = -1;
+		for( i = 0; i < face->num_charmaps && j == -1; i++ )
+		{
+			FT_CharMapRec* charmapRec = face->charmaps[i];
+			if( charmapRec->encoding == FT_ENCODING_UNICODE )
+				j = i;
+		}
+
+		if( j == -1 )
+			break;
+
+		error = FT_Set_Charmap( face, face->charmaps[j] );
+		if( error != FT_Err_Ok )
+			break;
+
+		error = FT_Set_Char_Size( face, 0, LAYOUT_PIXEL_SIZE*64, 0, 0 );
+		if( error != FT_Err_Ok )
+			break;
+
+		// Strikes get size objects of their own, so we remember this one to switch back to for layout.
+		layoutSize = face->size;
+
+		// The line height is the height of a capital letter, taken from the face rather than measured from rendered glyphs.
+		lineHeightMetric = 0;
+
+		// Older faces don't record a cap height, in which case the outline of an 'H' is measured without rendering it.
+		TT_OS2* os2 = ( TT_OS2* )FT_Get_Sfnt_Table( face, ft_sfnt_os2 );
+		if( os2 && os2->version >= 2 && os2->sCapHeight > 0 )
+			lineHeightMetric = GLuint( FT_MulFix( os2->sCapHeight, face->size->metrics.y_scale ) );
+		else if( FT_Load_Char( face, 'H', FT_LOAD_DEFAULT ) == FT_Err_Ok )
+			lineHeightMetric = GLuint( face->glyph->metrics.height );
+
+		if( lineHeightMetric == 0 )
+			lineHeightMetric = GLuint( face->size->metrics.ascender );
+
+		if( lineHeightMetric == 0 )
+			break;
+
+		quadBatch = new QuadBatch();
+
+		if( renderMode == System::RENDER_DISTANCE_FIELD )
+			distanceField = new DistanceField( DISTANCE_FIELD_SCALE, DISTANCE_FIELD_SPREAD );
+
+		// Kerning is looked up lazily as pairs show up in text.
+		kerningCache = new KerningCache();
+
+		glyphTable = new LookupTable< Glyph* >();
+
+		layoutCache = new LayoutCache();
+		displayListCache = new DisplayListCache();
+
+		if( !fontSystem->GetGlyphCacheDir().empty() )
+			OpenGlyphCacheFiles();
+
+		initialized = true;
+
+		success = true;
+	}
+	while( false );
+
+	if( !success && face )
+	{
+		fontSystem->LockLibrary();
+		FT_Done_Face( face );
+		fontSystem->UnlockLibrary();
+		face = nullptr;
+	}
+
+	if( !success )
+	{
+		SharedMappedFile::Release( fontData );
+		fontData = nullptr;
+	}
+
+	return success;
+}
+
+/*virtual*/ bool Font::Finalize( void )
+{
+	bool success = false;
+
+	do
+	{
+		while( glyphMap.size() > 0 )
+		{
+			GlyphMap::iterator iter = glyphMap.begin();
+			Glyph* glyph = iter->second;
+			if( glyph )
+			{
+				glyph->Finalize();
+				delete glyph;
+			}
+			glyphMap.erase( iter );
+		}
+
+		if( displayListCache )
+		{
+			displayListCache->Clear();
+			delete displayListCache;
+			displayListCache = nullptr;
+		}
+
+		for( int i = 0; i < STRIKE_COUNT; i++ )
+		{
+			Strike& strike = strikeArray[i];
+
+			if( strike.atlas )
+			{
+				strike.atlas->Finalize();
+				delete strike.atlas;
+				strike.atlas = nullptr;
+			}
+
+			// The face owns the layout size, which it frees along with itself.
+			if( strike.size && strike.size != layoutSize )
+				FT_Done_Size( strike.size );
+
+			strike.size = nullptr;
+
+			delete strike.cacheFile;
+			strike.cacheFile = nullptr;
+		}
+
+		metricsCacheFile = nullptr;
+		fontHash = 0;
+
+		delete quadBatch;
+		quadBatch = nullptr;
+
+		delete distanceField;
+		distanceField = nullptr;
+
+		delete kerningCache;
+		kerningCache = nullptr;
+
+		delete glyphTable;
+		glyphTable = nullptr;
+
+		delete layoutCache;
+		layoutCache = nullptr;
+
+		if( face )
+		{
+			fontSystem->LockLibrary();
+			FT_Done_Face( face );
+			fontSystem->UnlockLibrary();
+			face = nullptr;
+			layoutSize = nullptr;
+		}
+
+		// The face was reading from this, so it has to go first.
+		SharedMappedFile::Release( fontData );
+		fontData = nullptr;
+
+		initialized = false;
+
+		success = true;
+	}
+	while( false );
+	
+	return success;
+}
+
+Glyph* Font::GetOrCreateGlyph( FT_ULong charCode, System::Stats* stats )
+{
+	// Character codes are offset by one, since a key of zero marks an empty slot.
+	Glyph* cachedGlyph = nullptr;
+	if( glyphTable->Find( uint64_t( charCode ) + 1, cachedGlyph ) )
+	{
+		if( stats )
+			stats->glyphCacheHits++;
+
+		return cachedGlyph;
+	}
+
+	if( stats )
+		stats->glyphCacheMisses++;
+
+	LockFace();
+
+	// Another thread may have made the glyph while we waited.
+	if( glyphTable->Find( uint64_t( charCode ) + 1, cachedGlyph ) )
+	{
+		UnlockFace();
+		return cachedGlyph;
+	}
+
+	// Whether or not this works out, remember the result so that we only ever try once per character.
+	do
+	{
+		// Baked glyphs need nothing from FreeType.
+		const GlyphCacheFile::GlyphRecord* glyphRecord = metricsCacheFile ? metricsCacheFile->FindGlyph( charCode ) : nullptr;
+		if( glyphRecord )
+		{
+			FT_Glyph_Metrics metrics;
+			GlyphCacheFile::GetMetrics( glyphRecord->metrics, metrics );
+
+			cachedGlyph = new Glyph();
+			cachedGlyph->Initialize( metrics, glyphRecord->glyphIndex, charCode );
+			break;
+		}
+
+		FT_UInt glyphIndex = FT_Get_Char_Index( face, charCode );
+		if( glyphIndex == 0 )
+			break;
+
+		FT_Error error = FT_Activate_Size( layoutSize );
+		if( error != FT_Err_Ok )
+			break;
+
+		error = FT_Load_Glyph( face, glyphIndex, FT_LOAD_DEFAULT );
+		if( error != FT_Err_Ok )
+			break;
+
+		cachedGlyph = new Glyph();
+
+		if( !cachedGlyph->Initialize( face->glyph->metrics, glyphIndex, charCode ) )
+		{
+			delete cachedGlyph;
+			cachedGlyph = nullptr;
+		}
+	}
+	while( false );
+
+	// The map owns the glyphs, and the table finds them.
+	glyphMap[ charCode ] = cachedGlyph;
+	glyphTable->Insert( uint64_t( charCode ) + 1, cachedGlyph );
+
+	UnlockFace();
+
+	return cachedGlyph;
+}
+
+void Font::LockFace( void )
+{
+#if defined FONTSYS_THREADS
+	faceMutex.lock();
+#endif
+}
+
+void Font::UnlockFace( void )
+{
+#if defined FONTSYS_THREADS
+	faceMutex.unlock();
+#endif
+}
+
+bool Font::RasterizeGlyph( Glyph* glyph, int strike )
+{
+	bool success = false;
+
+	do
+	{
+		if( LoadCachedGlyphImage( glyph, strike ) )
+		{
+			success = true;
+			break;
+		}
+
+		Strike* rasterStrike = GetOrCreateStrike( strike );
+		if( !rasterStrike )
+			break;
+
+		LockFace();
+
+		bool rasterized = ( FT_Activate_Size( rasterStrike->size ) == FT_Err_Ok &&
+							RasterizeImage( face, glyph->GetIndex(), distanceField, rasterImage ) );
+
+		UnlockFace();
+
+		if( !rasterized )
+			break;
+
+		stats.glyphsRasterized++;
+
+		if( !CreateGlyphImage( glyph, strike, rasterImage ) )
+			break;
+
+		success = true;
+	}
+	while( false );
+
+	return success;
+}
+
+/*static*/ bool Font::RasterizeImage( FT_Face face, FT_UInt glyphIndex, DistanceField* distanceField, RasterImage& image )
+{
+	bool success = false;
+
+	do
+	{
+		FT_Error error = FT_Load_Glyph( face, glyphIndex, FT_LOAD_DEFAULT );
+		if( error != FT_Err_Ok )
+			break;
+
+		FT_GlyphSlot& glyphSlot = face->glyph;
+
+		if( glyphSlot->format != FT_GLYPH_FORMAT_BITMAP )
+		{
+			error = FT_Render_Glyph( glyphSlot, FT_RENDER_MODE_NORMAL );
+			if( error != FT_Err_Ok )
+				break;
+		}
+
+		const FT_Bitmap& bitmap = glyphSlot->bitmap;
+		if( bitmap.pixel_mode != FT_PIXEL_MODE_GRAY )
+			break;
+
+		image.metrics = glyphSlot->metrics;
+
+		// Some glyphs are just spaces, in which cases, there will be no buffer.
+		if( !bitmap.buffer )
+		{
+			image.width = 0;
+			image.height = 0;
+			image.buffer.clear();
+		}
+		else if( !distanceField )
+		{
+			image.width = bitmap.width;
+			image.height = bitmap.rows;
+			image.buffer.resize( image.width * image.height );
+
+			for( GLuint row = 0; row < image.height; row++ )
+				memcpy( &image.buffer[ row * image.width ], bitmap.buffer + GLint( row ) * bitmap.pitch, image.width );
+		}
+		else
+		{
+			if( !distanceField->Generate( bitmap ) )
+				break;
+
+			image.width = distanceField->GetWidth();
+			image.height = distanceField->GetHeight();
+			image.buffer.assign( distanceField->GetBuffer(), distanceField->GetBuffer() + image.width * image.height );
+
+			// The field covers the bitmap and its padding, so the image is described in source pixels to match.
+			GLuint scale = distanceField->GetScale();
+			FT_Pos padding = distanceField->GetPadding();
+
+			image.metrics.width = FT_Pos( image.width * scale ) * 64;
+			image.metrics.height = FT_Pos( image.height * scale ) * 64;
+			image.metrics.horiBearingX = ( glyphSlot->bitmap_left - padding ) * 64;
+			image.metrics.horiBearingY = ( glyphSlot->bitmap_top + padding ) * 64;
+		}
+
+		success = true;
+	}
+	while( false );
+
+	return success;
+}
+
+bool Font::CalcFontHash( void )
+{
+	if( !fontData )
+		return GlyphCacheFile::HashFontFile( fontFile, fontHash );
+
+	fontHash = GlyphCacheFile::HashFontData( fontData->GetData(), fontData->GetSize() );
+	return true;
+}
+
+bool Font::OpenGlyphCacheFiles( void )
+{
+	if( !CalcFontHash() )
+		return false;
+
+	for( int i = GetFirstStrike(); i < STRIKE_COUNT; i++ )
+	{
+		GlyphCacheFile::Key key;
+		MakeGlyphCacheKey( fontHash, STRIKE_PIXEL_SIZE[i], renderMode, key );
+
+		GlyphCacheFile* cacheFile = new GlyphCacheFile();
+		if( !cacheFile->Open( fontSystem->GetGlyphCacheDir() + "/" + GlyphCacheFile::MakeFileName( key ), key ) )
+		{
+			delete cacheFile;
+			continue;
+		}
+
+		strikeArray[i].cacheFile = cacheFile;
+
+		// Every file of the font has the same metrics and kerning, so any one of them will do for those.
+		if( !metricsCacheFile )
+			metricsCacheFile = cacheFile;
+	}
+
+	return true;
+}
+
+/*virtual*/ bool Font::BakeGlyphCache( const CharCodeArray& charCodeArray )
+{
+	bool success = false;
+
+	do
+	{
+		const std::string& glyphCacheDir = fontSystem->GetGlyphCacheDir();
+		if( glyphCacheDir.empty() )
+			break;
+
+		if( fontHash == 0 && !CalcFontHash() )
+			break;
+
+		// The files are sorted by character.
+		CharCodeArray sortedArray( charCodeArray );
+		std::sort( sortedArray.begin(), sortedArray.end() );
+		sortedArray.erase( std::unique( sortedArray.begin(), sortedArray.end() ), sortedArray.end() );
+
+		std::vector< Glyph* > glyphArray;
+		for( unsigned int i = 0; i < sortedArray.size(); i++ )
+		{
+			Glyph* glyph = GetOrCreateGlyph( sortedArray[i], &stats );
+			if( glyph )
+				glyphArray.push_back( glyph );
+		}
+
+		// Only pairs with kerning are kept, sorted by pair.
+		GlyphCacheFile::KerningRecordArray kerningRecordArray;
+		bool kerningComplete = true;
+
+		if( FT_HAS_KERNING( face ) )
+		{
+			if( glyphArray.size() > BAKE_KERNING_MAX_GLYPHS )
+				kerningComplete = false;
+			else
+			{
+				std::vector< FT_UInt > glyphIndexArray;
+				for( unsigned int i = 0; i < glyphArray.size(); i++ )
+					glyphIndexArray.push_back( glyphArray[i]->GetIndex() );
+
+				std::sort( glyphIndexArray.begin(), glyphIndexArray.end() );
+				glyphIndexArray.erase( std::unique( glyphIndexArray.begin(), glyphIndexArray.end() ), glyphIndexArray.end() );
+
+				LockFace();
+
+				FT_Activate_Size( layoutSize );
+
+				for( unsigned int i = 0; i < glyphIndexArray.size(); i++ )
+				{
+					for( unsigned int j = 0; j < glyphIndexArray.size(); j++ )
+					{
+						FT_Vector vector;
+						if( FT_Get_Kerning( face, glyphIndexArray[i], glyphIndexArray[j], FT_KERNING_DEFAULT, &vector ) != FT_Err_Ok || vector.x == 0 )
+							continue;
+
+						GlyphCacheFile::KerningRecord kerningRecord;
+						kerningRecord.leftGlyphIndex = glyphIndexArray[i];
+						kerningRecord.rightGlyphIndex = glyphIndexArray[j];
+						kerningRecord.kerning = int32_t( vector.x );
+						kerningRecordArray.push_back( kerningRecord );
+					}
+				}
+
+				UnlockFace();
+			}
+		}
+
+		int strike;
+		for( strike = GetFirstStrike(); strike < STRIKE_COUNT; strike++ )
+		{
+			std::vector< RasterImage > imageArray;
+			std::vector< char > rasterizedArray;
+			RasterizeImages( glyphArray, strike, true, imageArray, rasterizedArray );
+
+			GlyphCacheFile::GlyphRecordArray glyphRecordArray( glyphArray.size() );
+			GlyphCacheFile::ImageArray cacheImageArray( glyphArray.size(), nullptr );
+
+			for( unsigned int i = 0; i < glyphArray.size(); i++ )
+			{
+				GlyphCacheFile::GlyphRecord& glyphRecord = glyphRecordArray[i];
+				memset( &glyphRecord, 0, sizeof( GlyphCacheFile::GlyphRecord ) );
+				glyphRecord.charCode = uint32_t( glyphArray[i]->GetCharCode() );
+				glyphRecord.glyphIndex = glyphArray[i]->GetIndex();
+				GlyphCacheFile::SetMetrics( glyphArray[i]->GetMetrics(), glyphRecord.metrics );
+
+				if( rasterizedArray[i] )
+				{
+					const RasterImage& image = imageArray[i];
+					GlyphCacheFile::SetMetrics( image.metrics, glyphRecord.imageMetrics );
+					glyphRecord.imageWidth = image.width;
+					glyphRecord.imageHeight = image.height;
+					glyphRecord.hasImage = 1;
+
+					if( image.buffer.size() > 0 )
+						cacheImageArray[i] = &image.buffer[0];
+				}
+			}
+
+			GlyphCacheFile::Key key;
+			MakeGlyphCacheKey( fontHash, STRIKE_PIXEL_SIZE[ strike ], renderMode, key );
+
+			std::string path = glyphCacheDir + "/" + GlyphCacheFile::MakeFileName( key );
+			if( !GlyphCacheFile::Write( path, key, glyphRecordArray, cacheImageArray, kerningRecordArray, kerningComplete ) )
+				break;
+		}
+
+		if( strike < STRIKE_COUNT )
+			break;
+
+		success = true;
+	}
+	while( false );
+
+	return success;
+}
+
+bool Font::HasCachedGlyphImage( Glyph* glyph, int strike )
+{
+	GlyphCacheFile* cacheFile = strikeArray[ strike ].cacheFile;
+	if( !cacheFile )
+		return false;
+
+	const GlyphCacheFile::GlyphRecord* glyphRecord = cacheFile->FindGlyph( glyph->GetCharCode() );
+	return( glyphRecord && glyphRecord->hasImage );
+}
+
+bool Font::LoadCachedGlyphImage( Glyph* glyph, int strike )
+{
+	GlyphCacheFile* cacheFile = strikeArray[ strike ].cacheFile;
+	if( !cacheFile )
+		return false;
+
+	const GlyphCacheFile::GlyphRecord* glyphRecord = cacheFile->FindGlyph( glyph->GetCharCode() );
+	if( !glyphRecord || !glyphRecord->hasImage )
+		return false;
+
+	Strike* rasterStrike = GetOrCreateStrike( strike );
+	if( !rasterStrike )
+		return false;
+
+	FT_Glyph_Metrics metrics;
+	GlyphCacheFile::GetMetrics( glyphRecord->imageMetrics, metrics );
+
+	// The image goes from the mapping straight into the atlas.
+	FT_Bitmap bitmap;
+	memset( &bitmap, 0, sizeof( FT_Bitmap ) );
+	bitmap.width = glyphRecord->imageWidth;
+	bitmap.rows = glyphRecord->imageHeight;
+	bitmap.pitch = glyphRecord->imageWidth;
+	bitmap.buffer = ( unsigned char* )cacheFile->GetImage( *glyphRecord );
+	bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+
+	return glyph->CreateImage( strike, bitmap, metrics, rasterStrike->atlas );
+}
+
+bool Font::CreateGlyphImage( Glyph* glyph, int strike, const RasterImage& image )
+{
+	FT_Bitmap bitmap;
+	memset( &bitmap, 0, sizeof( FT_Bitmap ) );
+	bitmap.width = image.width;
+	bitmap.rows = image.height;
+	bitmap.pitch = image.width;
+	bitmap.buffer = image.buffer.size() > 0 ? ( unsigned char* )&image.buffer[0] : nullptr;
+	bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+
+	return glyph->CreateImage( strike, bitmap, image.metrics, strikeArray[ strike ].atlas );
+}
+
+/*virtual*/ bool Font::PreloadGlyphs( const CharCodeArray& charCodeArray )
+{
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
+
+	int strike = SelectStrike( params.lineHeight );
+	if( !GetOrCreateStrike( strike ) )
+		return false;
+
+	// Metrics are loaded here, since the glyph map belongs to this thread.  Only images are left to the workers.
+	std::vector< Glyph* > glyphArray;
+	std::unordered_set< Glyph* > glyphSet;
+
+	for( unsigned int i = 0; i < charCodeArray.size(); i++ )
+	{
+		Glyph* glyph = GetOrCreateGlyph( charCodeArray[i], &stats );
+		if( glyph && !glyph->GetImage( strike ) && !LoadCachedGlyphImage( glyph, strike ) && glyphSet.insert( glyph ).second )
+			glyphArray.push_back( glyph );
+	}
+
+	std::vector< RasterImage > imageArray;
+	std::vector< char > rasterizedArray;
+	RasterizeImages( glyphArray, strike, true, imageArray, rasterizedArray );
+
+	// The uploads happen here, in order, so that the atlas is packed the same way every time.
+	for( unsigned int i = 0; i < glyphArray.size(); i++ )
+		if( rasterizedArray[i] )
+			CreateGlyphImage( glyphArray[i], strike, imageArray[i] );
+
+	return true;
+}
+
+bool Font::PrepareGlyphs( const CharCodeArray& charCodeArray, GLfloat pixelHeight )
+{
+	pendingStrike = SelectStrikeForPixelHeight( pixelHeight );
+	if( !GetOrCreateStrike( pendingStrike ) )
+		return false;
+
+	pendingCachedGlyphArray.clear();
+	pendingGlyphArray.clear();
+	pendingIndex = 0;
+
+	std::unordered_set< Glyph* > glyphSet;
+
+	for( unsigned int i = 0; i < charCodeArray.size(); i++ )
+	{
+		Glyph* glyph = GetOrCreateGlyph( charCodeArray[i], &stats );
+		if( !glyph || glyph->GetImage( pendingStrike ) || !glyphSet.insert( glyph ).second )
+			continue;
+
+		// Baked images are already as good as rasterized.
+		if( HasCachedGlyphImage( glyph, pendingStrike ) )
+			pendingCachedGlyphArray.push_back( glyph );
+		else
+			pendingGlyphArray.push_back( glyph );
+	}
+
+	// The worker pool belongs to the GL thread, so we make do with this one.
+	RasterizeImages( pendingGlyphArray, pendingStrike, false, pendingImageArray, pendingRasterizedArray );
+
+	return true;
+}
+
+bool Font::UploadPendingImage( void )
+{
+	unsigned int cachedCount = unsigned( pendingCachedGlyphArray.size() );
+	unsigned int totalCount = cachedCount + unsigned( pendingGlyphArray.size() );
+
+	if( pendingIndex >= totalCount )
+	{
+		// Let go of the images now that they're all in the atlas.
+		pendingCachedGlyphArray.clear();
+		pendingGlyphArray.clear();
+		std::vector< RasterImage >().swap( pendingImageArray );
+		pendingRasterizedArray.clear();
+		pendingIndex = 0;
+		return false;
+	}
+
+	if( pendingIndex < cachedCount )
+		LoadCachedGlyphImage( pendingCachedGlyphArray[ pendingIndex ], pendingStrike );
+	else
+	{
+		unsigned int i = pendingIndex - cachedCount;
+		if( pendingRasterizedArray[i] )
+			CreateGlyphImage( pendingGlyphArray[i], pendingStrike, pendingImageArray[i] );
+	}
+
+	pendingIndex++;
+	return true;
+}
+
+void Font::RasterizeImages( const std::vector< Glyph* >& glyphArray, int strike, bool useWorkers, std::vector< RasterImage >& imageArray, std::vector< char >& rasterizedArray )
+{
+	imageArray.resize( glyphArray.size() );
+	rasterizedArray.assign( glyphArray.size(), 0 );
+
+	// Each worker has to open the font for itself, which isn't worth doing for a handful of glyphs.
+	if( useWorkers && glyphArray.size() >= PRELOAD_WORKER_MIN_GLYPHS )
+	{
+		WorkerPool* workerPool = fontSystem->GetWorkerPool();
+
+		std::vector< RasterWorker > workerArray( workerPool->GetWorkerCount() );
+
+		for( unsigned int i = 0; i < workerArray.size(); i++ )
+		{
+			workerArray[i].library = nullptr;
+			workerArray[i].face = nullptr;
+			workerArray[i].distanceField = nullptr;
+		}
+
+		workerPool->Run( unsigned( glyphArray.size() ), [&]( unsigned int worker, unsigned int index )
+		{
+			RasterWorker& rasterWorker = workerArray[ worker ];
+			if( !rasterWorker.library )
+				OpenRasterWorker( rasterWorker, strike );
+
+			if( !rasterWorker.face )
+				return;
+
+			if( RasterizeImage( rasterWorker.face, glyphArray[ index ]->GetIndex(), rasterWorker.distanceField, imageArray[ index ] ) )
+				rasterizedArray[ index ] = 1;
+		} );
+
+		for( unsigned int i = 0; i < workerArray.size(); i++ )
+			CloseRasterWorker( workerArray[i] );
+	}
+
+	// Whatever is left is done here, with our own face.
+	Strike* rasterStrike = GetOrCreateStrike( strike );
+	if( !rasterStrike )
+		return;
+
+	LockFace();
+
+	if( FT_Activate_Size( rasterStrike->size ) == FT_Err_Ok )
+	{
+		for( unsigned int i = 0; i < glyphArray.size(); i++ )
+			if( !rasterizedArray[i] && RasterizeImage( face, glyphArray[i]->GetIndex(), distanceField, imageArray[i] ) )
+				rasterizedArray[i] = 1;
+	}
+
+	UnlockFace();
+
+	stats.glyphsRasterized += std::count( rasterizedArray.begin(), rasterizedArray.end(), 1 );
+}
+
+bool Font::OpenRasterWorker( RasterWorker& rasterWorker, int strike )
+{
+	bool success = false;
+
+	do
+	{
+		FT_Error error = FT_Init_FreeType( &rasterWorker.library );
+		if( error != FT_Err_Ok )
+		{
+			rasterWorker.library = nullptr;
+			break;
+		}
+
+		// Glyphs are loaded by index, so there is no need to select a character map.  The mapping can be
+		// shared between threads, since nothing writes to it.
+		if( fontData )
+			error = FT_New_Memory_Face( rasterWorker.library, fontData->GetData(), FT_Long( fontData->GetSize() ), 0, &rasterWorker.face );
+		else
+			error = FT_New_Face( rasterWorker.library, fontFile.c_str(), 0, &rasterWorker.face );
+		if( error != FT_Err_Ok )
+		{
+			rasterWorker.face = nullptr;
+			break;
+		}
+
+		error = FT_Set_Char_Size( rasterWorker.face, 0, STRIKE_PIXEL_SIZE[ strike ] * 64, 0, 0 );
+		if( error != FT_Err_Ok )
+			break;
+
+		if( renderMode == System::RENDER_DISTANCE_FIELD )
+			rasterWorker.distanceField = new DistanceField( DISTANCE_FIELD_SCALE, DISTANCE_FIELD_SPREAD );
+
+		success = true;
+	}
+	while( false );
+
+	// A worker that failed to open keeps its library, so that it doesn't try again, but loses its face.
+	if( !success && rasterWorker.face )
+	{
+		FT_Done_Face( rasterWorker.face );
+		rasterWorker.face = nullptr;
+	}
+
+	return success;
+}
+
+/*static*/ void Font::CloseRasterWorker( RasterWorker& rasterWorker )
+{
+	delete rasterWorker.distanceField;
+	rasterWorker.distanceField = nullptr;
+
+	if( rasterWorker.face )
+	{
+		FT_Done_Face( rasterWorker.face );
+		rasterWorker.face = nullptr;
+	}
+
+	if( rasterWorker.library )
+	{
+		FT_Done_FreeType( rasterWorker.library );
+		rasterWorker.library = nullptr;
+	}
+}
+
+Font::Strike* Font::GetOrCreateStrike( int strike )
+{
+	Strike& rasterStrike = strikeArray[ strike ];
+
+	if( !rasterStrike.atlas )
+	{
+		GLuint pixelSize = STRIKE_PIXEL_SIZE[ strike ];
+
+		if( pixelSize == LAYOUT_PIXEL_SIZE )
+			rasterStrike.size = layoutSize;
+		else
+		{
+			LockFace();
+
+			bool sized = false;
+			if( FT_New_Size( face, &rasterStrike.size ) != FT_Err_Ok )
+				rasterStrike.size = nullptr;
+			else if( FT_Activate_Size( rasterStrike.size ) != FT_Err_Ok || FT_Set_Char_Size( face, 0, pixelSize*64, 0, 0 ) != FT_Err_Ok )
+			{
+				FT_Done_Size( rasterStrike.size );
+				rasterStrike.size = nullptr;
+			}
+			else
+				sized = true;
+
+			UnlockFace();
+
+			if( !sized )
+				return nullptr;
+		}
+
+		// Small strikes don't need big pages.  Roughly an eight by eight grid of em squares fits on a page.
+		GLuint pageSize = 256;
+		while( pageSize < pixelSize * 8 && pageSize < 1024 )
+			pageSize *= 2;
+
+		// Distance fields are much smaller than the strike they're made from.
+		if( distanceField )
+			pageSize = 512;
+
+		rasterStrike.atlas = new Atlas( pageSize );
+	}
+
+	return &rasterStrike;
+}
+
+int Font::SelectStrike( GLfloat lineHeight )
+{
+	return SelectStrikeForPixelHeight( CalcPixelHeight( lineHeight ) );
+}
+
+/*static*/ GLfloat Font::CalcPixelHeight( GLfloat lineHeight )
+{
+	GLfloat modelview[16], projection[16];
+	GLint viewport[4];
+
+	glGetFloatv( GL_MODELVIEW_MATRIX, modelview );
+	glGetFloatv( GL_PROJECTION_MATRIX, projection );
+	glGetIntegerv( GL_VIEWPORT, viewport );
+
+	// Take the bottom and top of a line of text at the origin through to window coordinates.
+	GLfloat window[2][2];
+	for( int i = 0; i < 2; i++ )
+	{
+		GLfloat point[4], clip[4];
+		for( int j = 0; j < 4; j++ )
+			point[j] = modelview[ 12 + j ] + ( i == 1 ? lineHeight * modelview[ 4 + j ] : 0.f );
+
+		for( int j = 0; j < 4; j++ )
+			clip[j] = projection[j] * point[0] + projection[ 4 + j ] * point[1] + projection[ 8 + j ] * point[2] + projection[ 12 + j ] * point[3];
+
+		// If the text is behind the eye, we have no idea how big it is.
+		if( clip[3] <= 0.f )
+			return -1.f;
+
+		window[i][0] = ( clip[0] / clip[3] ) * 0.5f * GLfloat( viewport[2] );
+		window[i][1] = ( clip[1] / clip[3] ) * 0.5f * GLfloat( viewport[3] );
+	}
+
+	GLfloat dx = window[1][0] - window[0][0];
+	GLfloat dy = window[1][1] - window[0][1];
+	return sqrtf( dx * dx + dy * dy );
+}
+
+int Font::SelectStrikeForPixelHeight( GLfloat pixelHeight )
+{
+	// Distance fields are only ever made from the layout size, since they scale well.
+	if( renderMode == System::RENDER_DISTANCE_FIELD )
+		return STRIKE_COUNT - 1;
+
+	// When we don't know how big the text is, we play it safe.
+	if( pixelHeight < 0.f )
+		return STRIKE_COUNT - 1;
+
+	// The line height is a cap height, so convert it to the em size that strikes are measured in.
+	GLfloat pixelSize = pixelHeight * GLfloat( LAYOUT_PIXEL_SIZE * 64 ) / GLfloat( lineHeightMetric );
+
+	// Use the smallest strike that won't have to be magnified.
+	int strike;
+	for( strike = 0; strike < STRIKE_COUNT - 1; strike++ )
+		if( GLfloat( STRIKE_PIXEL_SIZE[ strike ] ) >= pixelSize )
+			break;
+
+	return strike;
+}
+
+FT_Pos Font::GetKerning( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, System::Stats* stats )
+{
+	FT_Pos kerning = 0;
+
+	if( stats )
+		stats->kerningLookups++;
+
+	if( kerningCache->Lookup( leftGlyphIndex, rightGlyphIndex, kerning ) )
+		return kerning;
+
+	if( stats )
+		stats->kerningCacheMisses++;
+
+	LockFace();
+
+	// Each pair is looked up at most once, even if it has no kerning.  Baked pairs don't need FreeType at all.
+	if( !kerningCache->Lookup( leftGlyphIndex, rightGlyphIndex, kerning ) )
+	{
+		if( !metricsCacheFile || !metricsCacheFile->FindKerning( leftGlyphIndex, rightGlyphIndex, kerning ) )
+		{
+			// Kerning is scaled by the active size, which must be the layout size.
+			FT_Activate_Size( layoutSize );
+
+			FT_Vector vector;
+			if( FT_Get_Kerning( face, leftGlyphIndex, rightGlyphIndex, FT_KERNING_DEFAULT, &vector ) == FT_Err_Ok )
+				kerning = vector.x;
+		}
+
+		kerningCache->Insert( leftGlyphIndex, rightGlyphIndex, kerning );
+	}
+
+	UnlockFace();
+
+	return kerning;
+}
+
+/*virtual*/ size_t Font::GetTextureByteCount( void )
+{
+	size_t byteCount = 0;
+
+	for( int i = 0; i < STRIKE_COUNT; i++ )
+		if( strikeArray[i].atlas )
+			byteCount += strikeArray[i].atlas->GetTextureByteCount();
+
+	return byteCount;
+}
+
+/*virtual*/ void Font::GetStats( System::Stats& stats )
+{
+	stats = this->stats;
+	stats.displayListCount = displayListCache ? displayListCache->GetCount() : 0;
+	stats.textureByteCount = GetTextureByteCount();
+}
+
+/*virtual*/ void Font::ResetStats( void )
+{
+	memset( &stats, 0, sizeof( System::Stats ) );
+}
+
+// Batched draws are made by the system, but still counted against the font they were for.
+void Font::AddDrawCalls( unsigned int drawCount )
+{
+	stats.textureBinds += drawCount;
+	stats.drawCalls += drawCount;
+}
+
+/*virtual*/ bool Font::DisplayListCached( const std::string& text )
+{
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
+
+	MakeDisplayListKey( text, params, SelectStrike( params.lineHeight ), displayListKey );
+	return( displayListCache->Find( displayListKey ) ? true : false );
+}
+
+/*virtual*/ bool Font::PinStaticText( const std::string& text, bool pinned )
+{
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
+
+	int strike = SelectStrike( params.lineHeight );
+
+	// Pinning something we don't have yet compiles it without drawing it.
+	if( pinned && !RenderText( text, params, strike, true, false ) )
+		return false;
+
+	MakeDisplayListKey( text, params, strike, displayListKey );
+	return displayListCache->Pin( displayListKey, pinned );
+}
+
+/*virtual*/ bool Font::ReleaseStaticText( const std::string& text )
+{
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
+
+	MakeDisplayListKey( text, params, SelectStrike( params.lineHeight ), displayListKey );
+	return displayListCache->Remove( displayListKey );
+}
+
+/*virtual*/ bool Font::DrawText( const std::string& text, bool staticText /*= false*/ )
+{
+	bool success = false;
+
+	do
+	{
+		if( text.empty() )
+			break;
+
+		// While batching, nothing is drawn and no state is touched until the flush.
+		TextBatch* textBatch = fontSystem->GetTextBatch();
+		if( textBatch )
+		{
+			System::LayoutParams params;
+			fontSystem->GetLayoutParams( params );
+
+			return BatchText( text, params, SelectStrike( params.lineHeight ), textBatch );
+		}
+
+		BeginDraw();
+
+		System::LayoutParams params;
+		fontSystem->GetLayoutParams( params );
+
+		if( !RenderText( text, params, SelectStrike( params.lineHeight ), staticText, true ) )
+			break;
+
+		success = true;
+	}
+	while( false );
+
+	EndDraw();
+
+	return success;
+}
+
+void Font::BeginDraw( void )
+{
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+	glEnable( GL_TEXTURE_2D );
+	glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_BLEND );
+
+	GLfloat color[4];
+	glGetFloatv( GL_CURRENT_COLOR, color );
+	glTexEnvfv( GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, color );
+
+	// A distance field is cut off at its edge rather than blended.  The color's alpha scales the field,
+	// so the threshold is scaled to match.
+	if( renderMode == System::RENDER_DISTANCE_FIELD )
+	{
+		glDisable( GL_BLEND );
+		glEnable( GL_ALPHA_TEST );
+		glAlphaFunc( GL_GEQUAL, 0.5f * color[3] );
+	}
+}
+
+void Font::EndDraw( void )
+{
+	glDisable( GL_BLEND );
+	glDisable( GL_ALPHA_TEST );
+	glDisable( GL_TEXTURE_2D );
+}
+
+bool Font::RenderText( const std::string& text, const System::LayoutParams& params, int strike, bool staticText, bool execute )
+{
+	if( staticText )
+	{
+		displayListCache->SetLimits( fontSystem->GetRetainedTextByteBudget(), fontSystem->GetRetainedTextMaxCount() );
+
+		// Static text is keyed by its layout settings and strike too, so that changing them never replays a stale list.
+		MakeDisplayListKey( text, params, strike, displayListKey );
+
+		GLuint* displayList = displayListCache->Find( displayListKey );
+		if( displayList )
+		{
+			if( execute )
+			{
+				glCallList( *displayList );
+				stats.displayListCalls++;
+			}
+
+			return true;
+		}
+	}
+
+	const Layout* layout = LayoutText( text, params );
+	if( !layout || layout->glyphRun.size() == 0 )
+		return false;
+
+	// Glyph images are rasterized into the strike as they're first needed, so make sure it exists.
+	Strike* rasterStrike = GetOrCreateStrike( strike );
+	if( !rasterStrike )
+		return false;
+
+	if( !FillQuadBatch( *layout, params, strike ) )
+	{
+		quadBatch->Clear();
+		return false;
+	}
+
+	GLuint* displayList = nullptr;
+
+	if( staticText )
+	{
+		// A list holds roughly the vertex data along with a bind and a draw call per page.
+		size_t bytes = displayListKey.length() + 64 +
+						quadBatch->GetVertexCount() * sizeof( QuadBatch::Vertex ) +
+						quadBatch->GetPageCount() * 64;
+
+		displayList = displayListCache->Insert( displayListKey, bytes );
+		if( displayList )
+		{
+			*displayList = glGenLists(1);
+			if( *displayList != 0 )
+				glNewList( *displayList, execute ? GL_COMPILE_AND_EXECUTE : GL_COMPILE );
+			else
+			{
+				displayListCache->Remove( displayListKey );
+				displayList = nullptr;
+			}
+		}
+	}
+
+	if( execute || displayList )
+	{
+		unsigned int drawCount = quadBatch->Draw( rasterStrike->atlas );
+
+		// Calls that only go into a list aren't made until the list is.
+		if( execute )
+		{
+			stats.textureBinds += drawCount;
+			stats.drawCalls += drawCount;
+		}
+	}
+
+	if( displayList )
+		glEndList();
+
+	quadBatch->Clear();
+
+	return true;
+}
+
+bool Font::BatchText( const std::string& text, const System::LayoutParams& params, int strike, TextBatch* textBatch )
+{
+	const Layout* layout = LayoutText( text, params );
+	if( !layout || layout->glyphRun.size() == 0 )
+		return false;
+
+	Strike* rasterStrike = GetOrCreateStrike( strike );
+	if( !rasterStrike )
+		return false;
+
+	if( !FillQuadBatch( *layout, params, strike ) )
+	{
+		quadBatch->Clear();
+		return false;
+	}
+
+	GLfloat matrix[16];
+	glGetFloatv( GL_MODELVIEW_MATRIX, matrix );
+
+	GLfloat color[4];
+	glGetFloatv( GL_CURRENT_COLOR, color );
+
+	textBatch->AddQuads( this, rasterStrike->atlas, renderMode == System::RENDER_DISTANCE_FIELD, *quadBatch, matrix, color );
+
+	quadBatch->Clear();
+
+	return true;
+}
+
+bool Font::FillQuadBatch( const Layout& layout, const System::LayoutParams& params, int strike )
+{
+	// All lines go into one batch so that the whole text is drawn with as few calls as possible.
+	quadBatch->Clear();
+
+	GLfloat conversionFactor = CalcConversionFactor( params.lineHeight );
+
+	GLfloat baseLine = 0.f;
+	for( unsigned int i = 0; i < layout.lineArray.size(); i++ )
+	{
+		if( !RenderLine( layout, layout.lineArray[i], 0.f, baseLine, conversionFactor, strike ) )
+			return false;
+
+		baseLine += params.baseLineDelta;
+	}
+
+	return true;
+}
+
+bool Font::FillText( const std::string& text, const System::LayoutParams& params )
+{
+	quadBatch->Clear();
+
+	int strike = SelectStrike( params.lineHeight );
+	if( !GetOrCreateStrike( strike ) )
+		return false;
+
+	const Layout* layout = LayoutText( text, params );
+	if( !layout )
+		return false;
+
+	if( !FillQuadBatch( *layout, params, strike ) )
+	{
+		quadBatch->Clear();
+		return false;
+	}
+
+	return true;
+}
+
+Atlas* Font::GetStrikeAtlas( GLfloat lineHeight )
+{
+	Strike* rasterStrike = GetOrCreateStrike( SelectStrike( lineHeight ) );
+	return rasterStrike ? rasterStrike->atlas : nullptr;
+}
+
+bool Font::FillBufferLine( const std::string& text, size_t begin, const System::LayoutParams& params, GLfloat baseLine, size_t& next )
+{
+	int strike = SelectStrike( params.lineHeight );
+	if( !GetOrCreateStrike( strike ) )
+		return false;
+
+	Line line;
+	LayoutBufferLine( text, begin, params, line, next );
+
+	return RenderLine( scratchLayout, line, 0.f, baseLine, CalcConversionFactor( params.lineHeight ), strike );
+}
+
+bool Font::MeasureBufferLine( const std::string& text, size_t begin, const System::LayoutParams& params, GLfloat& width, size_t& next )
+{
+	Line line;
+	LayoutBufferLine( text, begin, params, line, next );
+
+	width = CalcLineLength( scratchLayout, line );
+	return true;
 }
 
-/*virtual*/ bool Font::Initialize( const std::string& font )
+void Font::LayoutBufferLine( const std::string& text, size_t begin, const System::LayoutParams& params, Line& line, size_t& next )
 {
-	bool success = false;
-	FT_Face face = nullptr;
+	double startTime = GetSeconds();
 
-	do
+	// A line never runs past the end of its paragraph.
+	size_t paragraphEnd = text.find( '\n', begin );
+	if( paragraphEnd == std::string::npos )
+		paragraphEnd = text.length();
+
+	bool wordWrap = ( params.lineWidth > 0.f && params.wordWrap );
+	GLfloat conversionFactor = CalcConversionFactor( params.lineHeight );
+	Layout& layout = scratchLayout;
+
+	// When wrapping, only so much of the paragraph is laid out as it takes to find the break, so that a line of a long
+	// paragraph costs about what the line does.  The window doubles until the break is found or the paragraph runs out.
+	size_t end = wordWrap ? std::min( paragraphEnd, begin + 256 ) : paragraphEnd;
+	size_t breakOffset = paragraphEnd;
+
+	while( true )
 	{
-		if( initialized )
-			break;
+		// The window must not split a character.
+		while( end < paragraphEnd && ( text[ end ] & 0xC0 ) == 0x80 )
+			end++;
 
-		std::string fontFile = fontSystem->ResolveFontPath( font );
+		GenerateGlyphRun( text.data() + begin, end - begin, conversionFactor, layout, &stats );
 
-		FT_Error error = FT_New_Face( fontSystem->GetLibrary(), fontFile.c_str(), 0, &face );
-		if( error != FT_Err_Ok || !face )
-			break;
+		if( FT_HAS_KERNING( face ) )
+			KernGlyphRun( conversionFactor, layout, &stats );
 
-		int i, j = -1;
-		for( i = 0; i < face->num_charmaps && j == -1; i++ )
+		// Only the first line, and those after newlines, start flush with the origin.  The rest are placed as LayoutText
+		// places the lines it wraps.
+		if( begin > 0 && text[ begin - 1 ] != '\n' && layout.glyphRun.size() > 0 )
 		{
-			FT_CharMapRec* charmapRec = face->charmaps[i];
-			if( charmapRec->encoding == FT_ENCODING_UNICODE )
-				j = i;
+			FT_Glyph_Metrics metrics;
+			layout.glyphRun[0].GetMetrics( metrics );
+			layout.glyphRun[0].x = GLfloat( metrics.horiBearingX ) * conversionFactor;
 		}
 
-		if( j == -1 )
+		line.first = 0;
+		line.count = unsigned( layout.glyphRun.size() );
+
+		if( !wordWrap )
 			break;
 
-		error = FT_Set_Charmap( face, face->charmaps[j] );
-		if( error != FT_Err_Ok )
+		// A break short of the window's end is just where it would be with the whole paragraph laid out.
+		unsigned int breakIndex = FindLineBreak( layout, line.first, line.count, params.lineWidth );
+		if( breakIndex < line.count )
+		{
+			line.count = breakIndex;
+
+			Utf8Decoder decoder( text.data() + begin, end - begin );
+			FT_ULong charCode;
+			for( unsigned int i = 0; i < breakIndex; i++ )
+				decoder.Next( charCode );
+
+			breakOffset = begin + decoder.GetOffset();
 			break;
+		}
 
-		error = FT_Set_Char_Size( face, 0, 128*64, 0, 0 );
-		if( error != FT_Err_Ok )
+		if( end == paragraphEnd )
 			break;
 
-		const wchar_t* charCodeString = L"abcdefghijklmnopqrstuvwxyz"
-										L"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
-										L"`~!@#$%^&*()_+-={}[],.<>/?'\";: ";
+		end = std::min( paragraphEnd, begin + 2 * ( end - begin ) );
+	}
 
-		lineHeightMetric = 0;
+	if( params.lineWidth > 0.f && params.justification != System::JUSTIFY_LEFT )
+		JustifyLine( layout, line, params );
 
-		for( i = 0; charCodeString[i] != '\0'; i++ )
+	// Spaces and unknown glyphs at a break are dropped, as in LayoutText, though never a newline.
+	next = breakOffset;
+	if( breakOffset < paragraphEnd )
+	{
+		Utf8Decoder decoder( text.data() + breakOffset, paragraphEnd - breakOffset );
+		FT_ULong charCode;
+		while( decoder.Next( charCode ) )
 		{
-			FT_ULong charCode = charCodeString[i];
-			FT_UInt glyphIndex = FT_Get_Char_Index( face, charCode );
-			if( glyphIndex == 0 )
-				continue;
-
-			error = FT_Load_Glyph( face, glyphIndex, FT_LOAD_DEFAULT );
-			if( error != FT_Err_Ok )
+			if( charCode != ' ' && GetOrCreateGlyph( charCode, &stats ) )
 				break;
 
-			FT_GlyphSlot& glyph = face->glyph;
+			next = breakOffset + decoder.GetOffset();
+		}
+	}
 
-			if( glyph->format != FT_GLYPH_FORMAT_BITMAP )
-			{
-				error = FT_Render_Glyph( glyph, FT_RENDER_MODE_NORMAL );
-				if( error != FT_Err_Ok )
-					break;
-			}
+	if( next == paragraphEnd && paragraphEnd < text.length() )
+		next++;
 
-			Glyph* cachedGlyph = new Glyph();
-			glyphMap[ charCode ] = cachedGlyph;
+	stats.layoutCount++;
+	stats.layoutSeconds += GetSeconds() - startTime;
+}
 
-			if( !cachedGlyph->Initialize( glyph, glyphIndex, charCode ) )
-				break;
+/*virtual*/ bool Font::CalcTextLength( const std::string& text, GLfloat& length )
+{
+	length = CalcRunLength( text, fontSystem->GetLineHeight(), scratchLayout, &stats );
+	return true;
+}
 
-			if( glyph->metrics.height == glyph->metrics.horiBearingY )
-				if( ( unsigned )glyph->metrics.height > lineHeightMetric )
-					lineHeightMetric = glyph->metrics.height;
-		}
+bool Font::CalcTextLength( const std::string& text, GLfloat lineHeight, GLfloat& length )
+{
+	Layout layout;
+	length = CalcRunLength( text, lineHeight, layout, nullptr );
+	return true;
+}
 
-		if( charCodeString[i] != '\0' )
-			break;
+GLfloat Font::CalcRunLength( const std::string& text, GLfloat lineHeight, Layout& layout, System::Stats* stats )
+{
+	if( text.empty() )
+		return 0.f;
 
-		if( lineHeightMetric == 0 )
-			break;
+	GLfloat conversionFactor = CalcConversionFactor( lineHeight );
 
-		kerningMap.clear();
+	GenerateGlyphRun( text.data(), text.length(), conversionFactor, layout, stats );
 
-		if( FT_HAS_KERNING( face ) )
-		{
-			for( i = 0; charCodeString[i] != '\0'; i++ )
-			{
-				FT_ULong leftCharCode = charCodeString[i];
-				FT_UInt leftGlyphIndex = FT_Get_Char_Index( face, leftCharCode );
-				if( leftGlyphIndex == 0 )
-					continue;
+	if( FT_HAS_KERNING( face ) )
+		KernGlyphRun( conversionFactor, layout, stats );
 
-				for( j = 0; j < charCodeString[j] != '\0'; j++ )
-				{
-					FT_ULong rightCharCode = charCodeString[j];
-					FT_UInt rightGlyphIndex = FT_Get_Char_Index( face, rightCharCode );
-					if( rightGlyphIndex == 0 )
-						continue;
+	// Newlines end lines without being drawn, so the text is as long as its longest line.  Lines after the first start
+	// flush with the origin, as BreakLines places them.
+	GLfloat length = 0.f;
+	unsigned int first = 0;
 
-					// TODO: I'm probably getting the kerning vector in the wrong units.
-					FT_Vector kerning;
-					FT_Get_Kerning( face, leftGlyphIndex, rightGlyphIndex, FT_KERNING_DEFAULT, &kerning );
+	for( unsigned int i = 0; i <= layout.newLineArray.size(); i++ )
+	{
+		unsigned int end = i < layout.newLineArray.size() ? layout.newLineArray[i] : unsigned( layout.glyphRun.size() );
 
-					FT_ULong key = MakeKerningKey( leftGlyphIndex, rightGlyphIndex );
-					kerningMap[ key ] = kerning;
-				}
-			}
-		}
+		if( first < end )
+		{
+			if( i > 0 )
+				layout.glyphRun[ first ].x = 0.f;
 
-		initialized = true;
+			Line line;
+			line.first = first;
+			line.count = end - first;
 
-		success = true;
-	}
-	while( false );
+			length = std::max( length, CalcLineLength( layout, line ) );
+		}
 
-	if( face )
-		FT_Done_Face( face );
+		first = end + 1;
+	}
 
-	return success;
+	return length;
 }
 
-/*virtual*/ bool Font::Finalize( void )
+/*virtual*/ bool Font::MeasureText( const std::string& text, System::TextMetrics& textMetrics )
 {
-	bool success = false;
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
 
-	do
+	if( text.empty() )
 	{
-		while( glyphMap.size() > 0 )
-		{
-			GlyphMap::iterator iter = glyphMap.begin();
-			Glyph* glyph = iter->second;
-			glyph->Finalize();
-			delete glyph;
-			glyphMap.erase( iter );
-		}
+		FillTextMetrics( Layout(), params, textMetrics );
+		return true;
+	}
 
-		while( textDisplayListMap.size() > 0 )
-		{
-			TextDisplayListMap::iterator iter = textDisplayListMap.begin();
-			GLuint displayList = iter->second;
-			glDeleteLists( displayList, 1 );
-			textDisplayListMap.erase( iter );
-		}
+	const Layout* layout = LayoutText( text, params );
+	if( !layout )
+		return false;
 
-		initialized = false;
+	FillTextMetrics( *layout, params, textMetrics );
+	return true;
+}
 
-		success = true;
-	}
-	while( false );
-	
-	return success;
+bool Font::MeasureText( const std::string& text, const System::LayoutParams& params, System::TextMetrics& textMetrics )
+{
+	// The layout is our own, so nothing here is shared with other threads but the lookup tables.
+	Layout layout;
+	if( !text.empty() )
+		BuildLayout( text, params, layout, nullptr );
+
+	FillTextMetrics( layout, params, textMetrics );
+	return true;
 }
 
-FT_ULong Font::MakeKerningKey( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex )
+bool Font::CalcTextLengths( const std::vector< std::string >& textArray, GLfloat lineHeight, std::vector< GLfloat >& lengthArray )
 {
-	FT_ULong left = leftGlyphIndex;
-	FT_ULong right = rightGlyphIndex;
+	lengthArray.resize( textArray.size() );
 
-	left = left << 16;		// I thought that longs were 64-bit while ints were 32-bit...?
+	RunLayoutJobs( unsigned( textArray.size() ), [&]( Layout& layout, System::Stats& workerStats, unsigned int index )
+	{
+		lengthArray[ index ] = CalcRunLength( textArray[ index ], lineHeight, layout, &workerStats );
+	} );
 
-	return( left | right );
+	return true;
 }
 
-/*virtual*/ bool Font::DisplayListCached( const std::string& text )
+bool Font::MeasureTexts( const std::vector< std::string >& textArray, const System::LayoutParams& params, std::vector< System::TextMetrics >& textMetricsArray )
 {
-	TextDisplayListMap::iterator iter = textDisplayListMap.find( text );
-	return( iter == textDisplayListMap.end() ? false : true );
+	textMetricsArray.resize( textArray.size() );
+
+	RunLayoutJobs( unsigned( textArray.size() ), [&]( Layout& layout, System::Stats& workerStats, unsigned int index )
+	{
+		BuildLayout( textArray[ index ], params, layout, &workerStats );
+		FillTextMetrics( layout, params, textMetricsArray[ index ] );
+	} );
+
+	return true;
 }
 
-/*virtual*/ bool Font::DrawText( const std::string& text, bool staticText /*= false*/ )
+void Font::RunLayoutJobs( unsigned int count, const LayoutJob& job )
 {
-	bool success = false;
-	GlyphChainVector glyphChainVector;
-	GLuint displayList = 0;
+	WorkerPool* workerPool = fontSystem->GetWorkerPool();
+	unsigned int workerCount = workerPool->GetWorkerCount();
 
-	do
+	if( workerLayoutArray.size() < workerCount )
+		workerLayoutArray.resize( workerCount );
+
+	workerStatsArray.resize( workerCount );
+	memset( &workerStatsArray[0], 0, workerCount * sizeof( System::Stats ) );
+
+	double startTime = GetSeconds();
+
+	workerPool->Run( count, [&]( unsigned int worker, unsigned int index )
 	{
-		if( text.empty() )
-			break;
+		job( workerLayoutArray[ worker ], workerStatsArray[ worker ], index );
+	} );
 
-		glEnable( GL_BLEND );
-		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+	for( unsigned int i = 0; i < workerCount; i++ )
+	{
+		const System::Stats& workerStats = workerStatsArray[i];
 
-		glEnable( GL_TEXTURE_2D );
-		glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_BLEND );
+		stats.glyphCacheHits += workerStats.glyphCacheHits;
+		stats.glyphCacheMisses += workerStats.glyphCacheMisses;
+		stats.kerningLookups += workerStats.kerningLookups;
+		stats.kerningCacheMisses += workerStats.kerningCacheMisses;
+	}
 
-		GLfloat color[4];
-		glGetFloatv( GL_CURRENT_COLOR, color );
-		glTexEnvfv( GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, color );
+	// Every item counts as a layout, and the time is the time the whole batch took.
+	stats.layoutCount += count;
+	stats.layoutSeconds += GetSeconds() - startTime;
+}
 
-		if( staticText )
-		{
-			TextDisplayListMap::iterator iter = textDisplayListMap.find( text );
-			if( iter != textDisplayListMap.end() )
-			{
-				displayList = iter->second;
-				glCallList( displayList );
-			}
-		}
+void Font::FillTextMetrics( const Layout& layout, const System::LayoutParams& params, System::TextMetrics& textMetrics )
+{
+	textMetrics.lineCount = 0;
+	textMetrics.lineWidthArray.clear();
+	textMetrics.minX = 0.f;
+	textMetrics.minY = 0.f;
+	textMetrics.maxX = 0.f;
+	textMetrics.maxY = 0.f;
 
-		if( displayList == 0 )
-		{
-			GLfloat conversionFactor = CalcConversionFactor();
-			std::wstring wideText = System::GetWide( text );
-			const wchar_t* charCodeString = wideText.c_str();
+	if( layout.glyphRun.size() == 0 )
+		return;
 
-			GlyphLink* glyphLink = GenerateGlyphChain( charCodeString, conversionFactor );
-			if( !glyphLink )
-				break;
+	textMetrics.lineCount = unsigned( layout.lineArray.size() );
+	textMetrics.lineWidthArray.resize( textMetrics.lineCount );
 
-			if( kerningMap.size() > 0 )
-				KernGlyphChain( glyphLink, conversionFactor );
+	// Lines are placed just as RenderLine places them.
+	bool empty = true;
+	GLfloat baseLine = 0.f;
 
-			glyphChainVector.push_back( glyphLink );
+	for( unsigned int i = 0; i < layout.lineArray.size(); i++ )
+	{
+		const Line& line = layout.lineArray[i];
 
-			if( fontSystem->GetLineWidth() > 0.f )
-			{
-				if( fontSystem->GetWordWrap() )
-				{
-					while( true )
-					{
-						glyphLink = BreakGlyphChain( glyphLink );
-						if( !glyphLink )
-							break;
-
-						while( !glyphLink->glyph || glyphLink->glyph->GetCharCode() == ' ' )
-						{
-							GlyphLink* deleteGlyphLink = glyphLink;
-							glyphLink = glyphLink->nextGlyphLink;
-							delete deleteGlyphLink;
-						}
-
-						glyphLink->dx = 0.f;
-						glyphChainVector.push_back( glyphLink );
-					}
-				}
+		textMetrics.lineWidthArray[i] = CalcLineLength( layout, line );
 
-				if( fontSystem->GetJustification() != System::JUSTIFY_LEFT )
-				{
-					for( unsigned int i = 0; i < glyphChainVector.size(); i++ )
-					{
-						glyphLink = glyphChainVector[i];
-						JustifyGlyphChain( glyphLink );
-					}
-				}
-			}
+		GLfloat ox = 0.f;
+		for( unsigned int j = line.first; j < line.first + line.count; j++ )
+		{
+			const PlacedGlyph& placedGlyph = layout.glyphRun[j];
 
-			if( staticText )
-			{
-				displayList = glGenLists(1);
-				glNewList( displayList, GL_COMPILE_AND_EXECUTE );
-			}
+			ox += placedGlyph.dx;
 
-			GLfloat baseLine = 0.f;
-			for( unsigned int i = 0; i < glyphChainVector.size(); i++ )
+			GLfloat x0 = ox + placedGlyph.x;
+			GLfloat y0 = baseLine + placedGlyph.y;
+			GLfloat x1 = x0 + placedGlyph.w;
+			GLfloat y1 = y0 + placedGlyph.h;
+
+			if( empty )
 			{
-				glyphLink = glyphChainVector[i];
-				RenderGlyphChain( glyphLink, 0.f, baseLine );
-				baseLine += fontSystem->GetBaseLineDelta();
+				textMetrics.minX = x0;
+				textMetrics.minY = y0;
+				textMetrics.maxX = x1;
+				textMetrics.maxY = y1;
+				empty = false;
 			}
-
-			if( staticText )
+			else
 			{
-				glEndList();
-				textDisplayListMap[ text ] = displayList;
+				textMetrics.minX = std::min( textMetrics.minX, x0 );
+				textMetrics.minY = std::min( textMetrics.minY, y0 );
+				textMetrics.maxX = std::max( textMetrics.maxX, x1 );
+				textMetrics.maxY = std::max( textMetrics.maxY, y1 );
 			}
 		}
 
-		success = true;
+		baseLine += params.baseLineDelta;
 	}
-	while( false );
+}
 
-	glDisable( GL_BLEND );
-	glDisable( GL_TEXTURE_2D );
+GLfloat Font::CalcConversionFactor( GLfloat lineHeight )
+{
+	return( lineHeight / GLfloat( lineHeightMetric ) );
+}
 
-	for( unsigned int i = 0; i < glyphChainVector.size(); i++ )
+const Font::Layout* Font::LayoutText( const std::string& text, const System::LayoutParams& params )
+{
+	size_t byteBudget = fontSystem->GetLayoutCacheBudget();
+	if( layoutCache->GetByteBudget() != byteBudget )
+		layoutCache->SetLimits( byteBudget, 0 );
+
+	// Note that the key buffer is reused so that a cache hit doesn't allocate.
+	if( byteBudget > 0 )
 	{
-		GlyphLink* glyphLink = glyphChainVector[i];
-		DeleteGlyphChain( glyphLink );
+		MakeLayoutKey( text, params, layoutKey );
+
+		Layout* cachedLayout = layoutCache->Find( layoutKey );
+		if( cachedLayout )
+			return cachedLayout;
 	}
 
-	return success;
-}
+	double startTime = GetSeconds();
 
-/*virtual*/ bool Font::CalcTextLength( const std::string& text, GLfloat& length )
-{
-	bool success = false;
-	GlyphLink* glyphLink = nullptr;
+	Layout& layout = scratchLayout;
+	BuildLayout( text, params, layout, &stats );
 
-	do
+	stats.layoutCount++;
+	stats.layoutSeconds += GetSeconds() - startTime;
+
+	if( byteBudget > 0 )
 	{
-		length = 0.f;
+		size_t bytes = sizeof( Layout ) + layoutKey.length() +
+						layout.glyphRun.size() * sizeof( PlacedGlyph ) +
+						layout.lineArray.size() * sizeof( Line ) +
+						layout.newLineArray.size() * sizeof( unsigned int );
 
-		if( !text.empty() )
+		Layout* cachedLayout = layoutCache->Insert( layoutKey, bytes );
+		if( cachedLayout )
 		{
-			GLfloat conversionFactor = CalcConversionFactor();
-			std::wstring wideText = System::GetWide( text.c_str() );
-			const wchar_t* charCodeString = wideText.c_str();
+			// Copying trims the buffers down to size, whereas the scratch layout keeps its capacity.
+			cachedLayout->glyphRun = layout.glyphRun;
+			cachedLayout->lineArray = layout.lineArray;
+			cachedLayout->newLineArray = layout.newLineArray;
+			return cachedLayout;
+		}
+	}
 
-			glyphLink = GenerateGlyphChain( charCodeString, conversionFactor );
-			if( !glyphLink )
-				break;
+	return &layout;
+}
 
-			if( kerningMap.size() > 0 )
-				KernGlyphChain( glyphLink, conversionFactor );
+void Font::BuildLayout( const std::string& text, const System::LayoutParams& params, Layout& layout, System::Stats* stats )
+{
+	GLfloat conversionFactor = CalcConversionFactor( params.lineHeight );
 
-			length = CalcGlyphChainLength( glyphLink );
-		}
+	GenerateGlyphRun( text.data(), text.length(), conversionFactor, layout, stats );
 
-		success = true;
-	}
-	while( false );
+	if( FT_HAS_KERNING( face ) )
+		KernGlyphRun( conversionFactor, layout, stats );
 
-	DeleteGlyphChain( glyphLink );
+	BreakLines( layout, params );
 
-	return true;
+	if( params.lineWidth > 0.f && params.justification != System::JUSTIFY_LEFT )
+	{
+		for( unsigned int i = 0; i < layout.lineArray.size(); i++ )
+			JustifyLine( layout, layout.lineArray[i], params );
+	}
+}
+
+/*static*/ void Font::MakeLayoutKey( const std::string& text, const System::LayoutParams& params, std::string& key )
+{
+	// Every setting that changes the layout goes into the key, ahead of the text.
+	key.assign( ( const char* )&params.lineWidth, sizeof( GLfloat ) );
+	key.append( ( const char* )&params.lineHeight, sizeof( GLfloat ) );
+	key.append( ( const char* )&params.baseLineDelta, sizeof( GLfloat ) );
+	key.push_back( char( params.justification ) );
+	key.push_back( params.wordWrap ? 1 : 0 );
+	key.append( text );
 }
 
-GLfloat Font::CalcConversionFactor( void )
+/*static*/ void Font::MakeDisplayListKey( const std::string& text, const System::LayoutParams& params, int strike, std::string& key )
 {
-	return( fontSystem->GetLineHeight() / GLfloat( lineHeightMetric ) );
+	MakeLayoutKey( text, params, key );
+	key.insert( key.begin(), char( strike ) );
 }
 
-void Font::GlyphLink::GetMetrics( FT_Glyph_Metrics& metrics ) const
+void Font::PlacedGlyph::GetMetrics( FT_Glyph_Metrics& metrics ) const
 {
 	if( glyph )
 		metrics = glyph->GetMetrics();
@@ -570,206 +2499,282 @@ void Font::GlyphLink::GetMetrics( FT_Glyph_Metrics& metrics ) const
 	}
 }
 
-Font::GlyphLink* Font::GenerateGlyphChain( const wchar_t* charCodeString, GLfloat conversionFactor )
+void Font::GenerateGlyphRun( const char* text, size_t length, GLfloat conversionFactor, Layout& layout, System::Stats* stats )
 {
-	GlyphLink* firstGlyphLink = nullptr;
-	GlyphLink* prevGlyphLink = nullptr;
+	// Note that clearing the run keeps its capacity, so this only allocates when the text gets longer than ever before.
+	GlyphRun& glyphRun = layout.glyphRun;
+	glyphRun.clear();
+	layout.newLineArray.clear();
 
-	for( int i = 0; charCodeString[i] != '\0'; i++ )
-	{
-		wchar_t charCode = charCodeString[i];
+	FT_Glyph_Metrics prevMetrics;
+	memset( &prevMetrics, 0, sizeof( FT_Glyph_Metrics ) );
 
-		Glyph* glyph = nullptr;
-		GlyphMap::iterator iter = glyphMap.find( charCode );
-		if( iter != glyphMap.end() )
-			glyph = iter->second;
+	// Characters are decoded straight out of the UTF-8 text as we go.
+	Utf8Decoder decoder( text, length );
+	FT_ULong charCode;
 
-		GlyphLink* glyphLink = new GlyphLink();
-		glyphLink->glyph = glyph;
+	for( int i = 0; decoder.Next( charCode ); i++ )
+	{
+		PlacedGlyph placedGlyph;
+		placedGlyph.glyph = GetOrCreateGlyph( charCode, stats );
 
 		FT_Glyph_Metrics metrics;
-		glyphLink->GetMetrics( metrics );
+		placedGlyph.GetMetrics( metrics );
 
-		glyphLink->w = GLfloat( metrics.width ) * conversionFactor;
-		glyphLink->h = GLfloat( metrics.height ) * conversionFactor;
+		placedGlyph.w = GLfloat( metrics.width ) * conversionFactor;
+		placedGlyph.h = GLfloat( metrics.height ) * conversionFactor;
+		placedGlyph.dy = 0.f;
+		placedGlyph.y = GLfloat( metrics.horiBearingY - metrics.height ) * conversionFactor;
 
-		if( !prevGlyphLink )
+		if( i == 0 )
 		{
-			glyphLink->dx = 0.f;
-			glyphLink->dy = 0.f;
-
-			glyphLink->x = 0.f;
-			glyphLink->y = GLfloat( metrics.horiBearingY - metrics.height ) * conversionFactor;
-
-			firstGlyphLink = glyphLink;
+			placedGlyph.dx = 0.f;
+			placedGlyph.x = 0.f;
 		}
 		else
 		{
-			FT_Glyph_Metrics prevMetrics;
-			prevGlyphLink->GetMetrics( prevMetrics );
-
-			glyphLink->dx = GLfloat( prevMetrics.horiAdvance ) * conversionFactor;
-			glyphLink->dy = 0.f;
-
-			glyphLink->x = GLfloat( metrics.horiBearingX ) * conversionFactor;
-			glyphLink->y = GLfloat( metrics.horiBearingY - metrics.height ) * conversionFactor;
-
-			prevGlyphLink->nextGlyphLink = glyphLink;
+			placedGlyph.dx = GLfloat( prevMetrics.horiAdvance ) * conversionFactor;
+			placedGlyph.x = GLfloat( metrics.horiBearingX ) * conversionFactor;
 		}
 
-		prevGlyphLink = glyphLink;
-	}
+		if( charCode == '\n' )
+			layout.newLineArray.push_back( unsigned( i ) );
 
-	return firstGlyphLink;
+		glyphRun.push_back( placedGlyph );
+		prevMetrics = metrics;
+	}
 }
 
-void Font::KernGlyphChain( GlyphLink* glyphLink, GLfloat conversionFactor )
+void Font::KernGlyphRun( GLfloat conversionFactor, Layout& layout, System::Stats* stats )
 {
-	GlyphLink* prevGlyphLink = nullptr;
+	GlyphRun& glyphRun = layout.glyphRun;
 
-	while( glyphLink )
+	for( unsigned int i = 1; i < glyphRun.size(); i++ )
 	{
-		if( prevGlyphLink && prevGlyphLink->glyph && glyphLink->glyph )
+		const PlacedGlyph& prevPlacedGlyph = glyphRun[ i - 1 ];
+		PlacedGlyph& placedGlyph = glyphRun[i];
+
+		if( prevPlacedGlyph.glyph && placedGlyph.glyph )
 		{
-			FT_ULong key = MakeKerningKey( prevGlyphLink->glyph->GetIndex(), glyphLink->glyph->GetIndex() );
-			KerningMap::iterator iter = kerningMap.find( key );
-			if( iter != kerningMap.end() )
-			{
-				FT_Vector kerning = iter->second;
-				glyphLink->dx += GLfloat( kerning.x ) * conversionFactor;
-			}
+			FT_Pos kerning = GetKerning( prevPlacedGlyph.glyph->GetIndex(), placedGlyph.glyph->GetIndex(), stats );
+			placedGlyph.dx += GLfloat( kerning ) * conversionFactor;
 		}
-
-		prevGlyphLink = glyphLink;
-		glyphLink = glyphLink->nextGlyphLink;
 	}
 }
 
-void Font::RenderGlyphChain( GlyphLink* glyphLink, GLfloat ox, GLfloat oy )
+bool Font::RenderLine( const Layout& layout, const Line& line, GLfloat ox, GLfloat oy, GLfloat conversionFactor, int strike )
 {
-	while( glyphLink )
+	Atlas* atlas = strikeArray[ strike ].atlas;
+
+	// This takes strike units to the same space that the layout is in.
+	GLfloat strikeFactor = conversionFactor * GLfloat( LAYOUT_PIXEL_SIZE ) / GLfloat( STRIKE_PIXEL_SIZE[ strike ] );
+
+	// Solid quads go on whatever page we're already using so that they don't split the batch.
+	int page = 0;
+
+	for( unsigned int i = line.first; i < line.first + line.count; i++ )
 	{
-		ox += glyphLink->dx;
-		oy += glyphLink->dy;
+		const PlacedGlyph& placedGlyph = layout.glyphRun[i];
 
-		GLuint texture = 0;
-		if( glyphLink->glyph )
-			texture = glyphLink->glyph->GetTexture();
+		ox += placedGlyph.dx;
+		oy += placedGlyph.dy;
 
-		// Note that if the 0-texture is bound, we should just draw a solid quad.
-		glBindTexture( GL_TEXTURE_2D, texture );
-		glBegin( GL_QUADS );
+		// Draw a solid quad for glyphs we don't have.
+		if( !placedGlyph.glyph )
+		{
+			// A new strike has no pages until its first image goes in, and this may come before that.
+			if( !atlas->AddFirstPage() )
+				return false;
 
-		glTexCoord2f( 0.f, 0.f );	glVertex2f( ox + glyphLink->x, oy + glyphLink->y );
-		glTexCoord2f( 1.f, 0.f );	glVertex2f( ox + glyphLink->x + glyphLink->w, oy + glyphLink->y );
-		glTexCoord2f( 1.f, 1.f );	glVertex2f( ox + glyphLink->x + glyphLink->w, oy + glyphLink->y + glyphLink->h );
-		glTexCoord2f( 0.f, 1.f );	glVertex2f( ox + glyphLink->x, oy + glyphLink->y + glyphLink->h );
+			Atlas::Region region;
+			atlas->GetSolidRegion( page, region );
 
-		glEnd();
+			// The baseline is added last, so that a line comes out the same wherever it lies.
+			GLfloat x = ox + placedGlyph.x;
+			GLfloat y0 = placedGlyph.y;
+			GLfloat y1 = y0 + placedGlyph.h;
 
-		glyphLink = glyphLink->nextGlyphLink;
-	}
-}
+			quadBatch->AddQuad( page, x, oy + y0, x + placedGlyph.w, oy + y1, region.s0, region.t0, region.s1, region.t1 );
+			continue;
+		}
 
-void Font::DeleteGlyphChain( GlyphLink* glyphLink )
-{
-	while( glyphLink )
-	{
-		GlyphLink* nextGlyphLink = glyphLink->nextGlyphLink;
-		delete glyphLink;
-		glyphLink = nextGlyphLink;
+		const Glyph::Image* image = placedGlyph.glyph->GetImage( strike );
+		if( !image )
+		{
+			RasterizeGlyph( placedGlyph.glyph, strike );
+			image = placedGlyph.glyph->GetImage( strike );
+		}
+
+		// There is nothing to draw for glyphs like spaces.
+		if( !image || image->page < 0 )
+			continue;
+
+		page = image->page;
+
+		// Hinting at the strike size moves the image a little, so it is placed by its own metrics,
+		// relative to where the layout put the glyph's box.
+		const FT_Glyph_Metrics& layoutMetrics = placedGlyph.glyph->GetMetrics();
+		const FT_Glyph_Metrics& imageMetrics = image->metrics;
+
+		GLfloat x = ox + placedGlyph.x + GLfloat( imageMetrics.horiBearingX ) * strikeFactor - GLfloat( layoutMetrics.horiBearingX ) * conversionFactor;
+		GLfloat y0 = GLfloat( imageMetrics.horiBearingY - imageMetrics.height ) * strikeFactor;
+		GLfloat w = GLfloat( imageMetrics.width ) * strikeFactor;
+		GLfloat y1 = y0 + GLfloat( imageMetrics.height ) * strikeFactor;
+
+		quadBatch->AddQuad( page, x, oy + y0, x + w, oy + y1, image->s0, image->t0, image->s1, image->t1 );
 	}
+
+	return true;
 }
 
-GLfloat Font::CalcGlyphChainLength( GlyphLink* glyphLink )
+GLfloat Font::CalcLineLength( const Layout& layout, const Line& line )
 {
 	GLfloat length = 0.f;
 
-	while( glyphLink )
+	if( line.count > 0 )
 	{
-		if( glyphLink->nextGlyphLink )
-			length += glyphLink->nextGlyphLink->dx;
-		else
-			length += glyphLink->x + glyphLink->w;
+		// Each glyph is as long as the distance to the next glyph's origin; the last one is as long as its box reaches.
+		for( unsigned int i = line.first + 1; i < line.first + line.count; i++ )
+			length += layout.glyphRun[i].dx;
 
-		glyphLink = glyphLink->nextGlyphLink;
+		const PlacedGlyph& lastPlacedGlyph = layout.glyphRun[ line.first + line.count - 1 ];
+		length += lastPlacedGlyph.x + lastPlacedGlyph.w;
 	}
 
 	return length;
 }
 
-// TODO: We should force a break on new-line characters.
-Font::GlyphLink* Font::BreakGlyphChain( GlyphLink* glyphLink )
+// Lines are broken in one pass over the run.  A line's scan picks up where the last one broke, so no glyph is looked at
+// more than twice, whatever the length of the text.
+void Font::BreakLines( Layout& layout, const System::LayoutParams& params )
 {
-	GLfloat ox = 0.f;
+	layout.lineArray.clear();
 
-	GlyphLink* prevGlyphLink = nullptr;
-	GlyphLink* glyphLinkBreak = nullptr;
-	GlyphLink* prevGlyphLinkBreak = nullptr;
+	bool wordWrap = ( params.lineWidth > 0.f && params.wordWrap );
+	unsigned int glyphCount = unsigned( layout.glyphRun.size() );
+	unsigned int first = 0;
 
-	while( true )
+	// Each newline ends a paragraph.  What follows the last one is only a paragraph if there's something to it.
+	for( unsigned int i = 0; i <= layout.newLineArray.size(); i++ )
 	{
-		if( !glyphLink )
-			return nullptr;		// All glyphs are in bounds.
+		unsigned int end = i < layout.newLineArray.size() ? layout.newLineArray[i] : glyphCount;
+		if( i == layout.newLineArray.size() && first == end )
+			break;
 
-		ox += glyphLink->dx;
+		// A paragraph starts flush with the origin, like the text does.
+		if( i > 0 && first < end )
+		{
+			layout.glyphRun[ first ].dx = 0.f;
+			layout.glyphRun[ first ].x = 0.f;
+		}
 
-		if( ox + glyphLink->x + glyphLink->w >= fontSystem->GetLineWidth() )
-			break;				// We reached a glyph out of bounds.
+		Line line;
+		line.first = first;
 
-		if( !glyphLink->glyph || glyphLink->glyph->GetCharCode() == ' ' )
+		while( true )
 		{
-			glyphLinkBreak = glyphLink;
-			prevGlyphLinkBreak = prevGlyphLink;
+			unsigned int breakIndex = wordWrap ? FindLineBreak( layout, line.first, end, params.lineWidth ) : end;
+
+			line.count = breakIndex - line.first;
+			layout.lineArray.push_back( line );
+
+			// Spaces and unknown glyphs at the break are dropped.
+			while( breakIndex < end )
+			{
+				const PlacedGlyph& placedGlyph = layout.glyphRun[ breakIndex ];
+				if( placedGlyph.glyph && placedGlyph.glyph->GetCharCode() != ' ' )
+					break;
+
+				breakIndex++;
+			}
+
+			if( breakIndex == end )
+				break;
+
+			layout.glyphRun[ breakIndex ].dx = 0.f;
+			line.first = breakIndex;
 		}
 
-		prevGlyphLink = glyphLink;
-		glyphLink = glyphLink->nextGlyphLink;
+		first = end + 1;
 	}
+}
 
-	if( !prevGlyphLinkBreak )
-		return nullptr;
+// Return where a line from the first glyph should break to fit the width: at the last space or unknown glyph before
+// the first glyph out of bounds, or if there's none, at the first one after it, so that a word too long for a line
+// gets a line of its own.  The end is returned if the line fits, or has nowhere to break.
+unsigned int Font::FindLineBreak( const Layout& layout, unsigned int first, unsigned int end, GLfloat lineWidth )
+{
+	GLfloat ox = 0.f;
+	unsigned int breakIndex = end;
+	bool outOfBounds = false;
+
+	for( unsigned int i = first; i < end; i++ )
+	{
+		const PlacedGlyph& placedGlyph = layout.glyphRun[i];
+
+		if( !outOfBounds )
+		{
+			ox += placedGlyph.dx;
+
+			if( ox + placedGlyph.x + placedGlyph.w >= lineWidth )
+			{
+				if( breakIndex < end )
+					return breakIndex;
+
+				outOfBounds = true;
+			}
+		}
+
+		if( i > first && ( !placedGlyph.glyph || placedGlyph.glyph->GetCharCode() == ' ' ) )
+		{
+			if( outOfBounds )
+				return i;
+
+			breakIndex = i;
+		}
+	}
 
-	prevGlyphLinkBreak->nextGlyphLink = nullptr;
-	return glyphLinkBreak;
+	return end;
 }
 
-void Font::JustifyGlyphChain( GlyphLink* glyphLink )
+void Font::JustifyLine( Layout& layout, const Line& line, const System::LayoutParams& params )
 {
-	GLfloat length = CalcGlyphChainLength( glyphLink );
-	GLfloat delta = fontSystem->GetLineWidth() - length;
+	if( line.count == 0 )
+		return;
+
+	GLfloat length = CalcLineLength( layout, line );
+	GLfloat delta = params.lineWidth - length;
 
-	switch( fontSystem->GetJustification() )
+	switch( params.justification )
 	{
 		case System::JUSTIFY_LEFT:
 		{
-			// We assume that the given chain is already left-justify; so in this case, we're done!
+			// We assume that the given line is already left-justify; so in this case, we're done!
 			break;
 		}
 		case System::JUSTIFY_RIGHT:
 		{
-			glyphLink->dx += delta;
+			layout.glyphRun[ line.first ].dx += delta;
 			break;
 		}
 		case System::JUSTIFY_CENTER:
 		{
-			glyphLink->dx += delta / 2.f;
+			layout.glyphRun[ line.first ].dx += delta / 2.f;
 			break;
 		}
 		case System::JUSTIFY_LEFT_AND_RIGHT:
 		{
-			int spaceCount = CountGlyphsInChain( glyphLink, ' ' );
+			int spaceCount = CountGlyphsInLine( layout, line, ' ' );
 			if( spaceCount > 0 )
 			{
 				delta /= GLfloat( spaceCount );
 
 				// TODO: We may want to leave it left-justified if the delta is too big.
-				while( glyphLink )
+				for( unsigned int i = line.first; i < line.first + line.count; i++ )
 				{
-					if( glyphLink->glyph && glyphLink->glyph->GetCharCode() == ' ' )
-						glyphLink->dx += delta;
-
-					glyphLink = glyphLink->nextGlyphLink;
+					PlacedGlyph& placedGlyph = layout.glyphRun[i];
+					if( placedGlyph.glyph && placedGlyph.glyph->GetCharCode() == ' ' )
+						placedGlyph.dx += delta;
 				}
 			}
 
@@ -778,16 +2783,15 @@ void Font::JustifyGlyphChain( GlyphLink* glyphLink )
 	}
 }
 
-int Font::CountGlyphsInChain( GlyphLink* glyphLink, FT_ULong charCode )
+int Font::CountGlyphsInLine( const Layout& layout, const Line& line, FT_ULong charCode )
 {
 	int count = 0;
 
-	while( glyphLink )
+	for( unsigned int i = line.first; i < line.first + line.count; i++ )
 	{
-		if( glyphLink->glyph && glyphLink->glyph->GetCharCode() == charCode )
+		const PlacedGlyph& placedGlyph = layout.glyphRun[i];
+		if( placedGlyph.glyph && placedGlyph.glyph->GetCharCode() == charCode )
 			count++;
-
-		glyphLink = glyphLink->nextGlyphLink;
 	}
 
 	return count;
@@ -795,7 +2799,8 @@ int Font::CountGlyphsInChain( GlyphLink* glyphLink, FT_ULong charCode )
 
 Glyph::Glyph( void )
 {
-	texture = 0;
+	for( int i = 0; i < STRIKE_COUNT; i++ )
+		imageCreated[i] = false;
 	glyphIndex = 0;
 	charCode = 0;
 }
@@ -805,24 +2810,33 @@ Glyph::Glyph( void )
 	Finalize();
 }
 
-bool Glyph::Initialize( FT_GlyphSlot& glyphSlot, FT_UInt glyphIndex, FT_ULong charCode )
+bool Glyph::Initialize( const FT_Glyph_Metrics& metrics, FT_UInt glyphIndex, FT_ULong charCode )
+{
+	this->glyphIndex = glyphIndex;
+	this->charCode = charCode;
+	this->metrics = metrics;
+
+	return true;
+}
+
+bool Glyph::CreateImage( int strike, const FT_Bitmap& bitmap, const FT_Glyph_Metrics& metrics, Atlas* atlas )
 {
 	bool success = false;
+
+	Image& image = imageArray[ strike ];
+	image.page = -1;
+	image.s0 = image.t0 = image.s1 = image.t1 = 0.f;
+	image.metrics = metrics;
+	imageCreated[ strike ] = true;
 	
 	do
 	{
-		this->glyphIndex = glyphIndex;
-		this->charCode = charCode;
-
-		FT_Bitmap& bitmap = glyphSlot->bitmap;
 		if( bitmap.pixel_mode != FT_PIXEL_MODE_GRAY )
 			break;
 
 		if( bitmap.pitch != bitmap.width )
 			break;
 
-		metrics = glyphSlot->metrics;
-
 		GLuint width = bitmap.width;
 		GLuint height = bitmap.rows;
 
@@ -831,41 +2845,15 @@ bool Glyph::Initialize( FT_GlyphSlot& glyphSlot, FT_UInt glyphIndex, FT_ULong ch
 		GLubyte* bitmapBuffer = ( GLubyte* )bitmap.buffer;
 		if( bitmapBuffer != nullptr )
 		{
-			glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-
-			glGenTextures( 1, &texture );
-			if( texture == 0 )
+			Atlas::Region region;
+			if( !atlas->Insert( bitmapBuffer, width, height, bitmap.pitch, region ) )
 				break;
 
-			glBindTexture( GL_TEXTURE_2D, texture );
-
-			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
-			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
-			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-
-			GLuint bytesPerTexel = 4;
-			GLubyte* textureBuffer = new GLubyte[ width * height * bytesPerTexel ];
-
-			// We have to flip the image for OpenGL.
-			for( GLuint i = 0; i < height; i++ )
-			{
-				for( GLuint j = 0; j < width; j++ )
-				{
-					GLubyte grey = bitmapBuffer[ ( height - i - 1 ) * width + j ];
-
-					GLubyte* texel = &textureBuffer[ ( i * width + j  ) * bytesPerTexel ];
-
-					texel[0] = grey;
-					texel[1] = grey;
-					texel[2] = grey;
-					texel[3] = grey;
-				}
-			}
-
-			gluBuild2DMipmaps( GL_TEXTURE_2D, GL_RGBA, width, height, GL_RGBA, GL_UNSIGNED_BYTE, textureBuffer );
-
-			delete[] textureBuffer;
+			image.page = region.page;
+			image.s0 = region.s0;
+			image.t0 = region.t0;
+			image.s1 = region.s1;
+			image.t1 = region.t1;
 		}
 
 		success = true;
@@ -877,8 +2865,9 @@ bool Glyph::Initialize( FT_GlyphSlot& glyphSlot, FT_UInt glyphIndex, FT_ULong ch
 
 bool Glyph::Finalize( void )
 {
-	if( texture != 0 )
-		glDeleteTextures( 1, &texture );
+	// Our images belong to the font's atlases, which free them.
+	for( int i = 0; i < STRIKE_COUNT; i++ )
+		imageCreated[i] = false;
 
 	return true;
 }
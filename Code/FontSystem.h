@@ -5,6 +5,9 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <set>
+#include <functional>
+#include <stdint.h>
 #if defined WIN32
 #	include <windows.h>
 #endif
@@ -13,16 +16,44 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+// Visual Studio 2010 has no standard thread library, in which case everything runs on the calling thread.
+#if !defined _MSC_VER || _MSC_VER >= 1700
+#	define FONTSYS_THREADS
+#	include <mutex>
+#	include <atomic>
+#endif
+
 namespace FontSys
 {
 	class Font;
 	class Glyph;
 	class System;
+	class Atlas;
+	class QuadBatch;
+	class KerningCache;
+	class Utf8Decoder;
+	template< typename Value > class LruCache;
+	template< typename Value > class LookupTable;
+	class DisplayListCache;
+	class DistanceField;
+	class WorkerPool;
+	class MappedFile;
+	class GlyphCacheFile;
+	class FontLoader;
+	class SharedMappedFile;
+	class TextBatch;
+	class TextBuffer;
+	class TextDocument;
+	class RetainedText;
+	class GLFunctions;
 
 	typedef std::map< std::string, Font* > FontMap;
-	typedef std::map< std::string, GLuint > TextDisplayListMap;
+	typedef std::map< std::string, size_t > FontByteCountMap;
 	typedef std::map< FT_ULong, Glyph* > GlyphMap;
-	typedef std::map< FT_ULong, FT_Vector > KerningMap;
+	typedef std::vector< FT_ULong > CharCodeArray;
+
+	// Glyph images are rasterized at this many sizes, called strikes, so that small text samples small textures.
+	const int STRIKE_COUNT = 7;
 }
 
 // An instance of this class is a layer of software that sits between
@@ -65,48 +96,242 @@ public:
 	void SetFontBaseDir( const std::string& fontBaseDir ) { this->fontBaseDir = fontBaseDir; }
 	const std::string& GetFontBaseDir( void ) { return fontBaseDir; }
 
+	// Wrapped lines break at spaces.  A word too long for a line gets one to itself.  Newlines always end a line,
+	// wrapping or not.
 	void SetWordWrap( bool wordWrap ) { this->wordWrap = wordWrap; }
 	bool GetWordWrap( void ) { return wordWrap; }
 
+	// Glyphs are normally drawn from coverage bitmaps rasterized near the size they appear on screen.
+	// Distance field glyphs are rasterized once, into much smaller textures, and stay sharp at any scale.
+	// They are alpha-tested rather than blended, though, so their edges are hard and the current color's alpha is ignored.
+	enum RenderMode
+	{
+		RENDER_COVERAGE,
+		RENDER_DISTANCE_FIELD,
+	};
+
+	// The mode applies to the current font; each font and mode pair is cached separately.
+	void SetRenderMode( RenderMode renderMode ) { this->renderMode = renderMode; }
+	RenderMode GetRenderMode( void ) { return renderMode; }
+
+	// These are all the settings that affect how text is laid out.
+	struct LayoutParams
+	{
+		GLfloat lineWidth, lineHeight;
+		GLfloat baseLineDelta;
+		Justification justification;
+		bool wordWrap;
+	};
+
+	void GetLayoutParams( LayoutParams& params );
+	static bool LayoutParamsMatch( const LayoutParams& paramsA, const LayoutParams& paramsB );
+
+	// Each font can remember the layouts of recently drawn dynamic text, up to the given number of bytes.
+	// Repeated text with unchanged settings then skips layout entirely.  A budget of zero, the default, turns this off.
+	void SetLayoutCacheBudget( size_t layoutCacheBudget ) { this->layoutCacheBudget = layoutCacheBudget; }
+	size_t GetLayoutCacheBudget( void ) { return layoutCacheBudget; }
+
 	// When called, we assume that an OpenGL context is already bound.  Only one font
 	// system should be used per context since the system caches texture objects and display lists.
 	// To position and orient text, the caller must setup the appropriate modelview matrix.
 	// The object-space of the text begins on the positive X-axis and then subsequent lines fill the 4th quadrant of the XY-plane.
 	// The given flag can be set to true in the case that the text will never change.  This causes
-	// us to use and cache a display list for rendering.  If the flag is falsely set for dynamic text,
-	// OpenGL may run out of display list memory and/or otherwise bog down!
+	// us to use and cache a display list for rendering, keyed by the text and the current layout settings.
+	// The cache is bounded (see SetRetainedTextLimits), so falsely flagged dynamic text only churns it.
 	bool DrawText( const std::string& text, bool staticText = false );
 
 	// This is provided for convenience when a simple translation is all that's required.
 	bool DrawText( GLfloat x, GLfloat y, const std::string& text, bool staticText = false );
 
+	// Between these, text isn't drawn but laid out and collected, along with the modelview matrix and color of each draw.
+	// Flush then draws it all with one call per atlas page, grouped by font, and ends the batch.  The projection
+	// and viewport must not change before the flush.  Batched text can be drawn in a different order than it
+	// was given, and static text is batched like dynamic text, without a display list.
+	bool BeginBatch( void );
+	bool Flush( void );
+
+	// This is null unless a batch has begun.
+	TextBatch* GetTextBatch( void ) { return batching ? textBatch : nullptr; }
+
+	// This is the font of the current settings, loaded as need be, or null if it can't be.
+	Font* GetCurrentFont( void ) { return GetOrCreateCachedFont(); }
+
 	// Get around linker error that I can't figure out.
 	bool DrawTextCPtr( const char* text, bool staticText = false );
 
-	// This ignores wrapping.
+	// This ignores wrapping, but not newlines: text of several lines is as long as its longest.
 	bool CalcTextLength( const std::string& text, GLfloat& length );
 
-	// Tell us if a display list is cached for the given string.
+	// This is how text comes out when laid out under the current settings, wrapping and justification included.
+	// Line widths don't count the space justification puts before a line, but the box, which bounds every glyph
+	// box in the object space of DrawText, does.
+	struct TextMetrics
+	{
+		unsigned int lineCount;
+		std::vector< GLfloat > lineWidthArray;
+		GLfloat minX, minY;
+		GLfloat maxX, maxY;
+	};
+
+	// Measuring uses nothing but font metrics, so it needs no OpenGL context.  A system that only ever
+	// measures can be used where there is no GPU at all, or on a thread other than the one that draws.
+	bool MeasureText( const std::string& text, TextMetrics& textMetrics );
+
+	// These are for measuring on any number of threads at once, alongside the drawing thread.  They take the font and
+	// settings to use, since the system's own belong to the drawing thread.  Fonts are loaded for them as need be.
+	// The font base directory and render mode must be set before they start, and Finalize must wait until they're done.
+	// They aren't counted in the stats.
+	bool CalcTextLength( const std::string& font, GLfloat lineHeight, const std::string& text, GLfloat& length );
+	bool MeasureText( const std::string& font, const LayoutParams& params, const std::string& text, TextMetrics& textMetrics );
+
+	// These measure many strings at once under the current settings, with the work spread over the worker pool, and
+	// give back an array to match the given one, item for item.  Unlike the above, they're for the drawing thread.
+	// Giving the same arrays back, call after call, saves reallocating them.
+	bool CalcTextLengths( const std::vector< std::string >& textArray, std::vector< GLfloat >& lengthArray );
+	bool MeasureTexts( const std::vector< std::string >& textArray, std::vector< TextMetrics >& textMetricsArray );
+
+	// Tell us if a display list is cached for the given string under the current settings.
 	bool DisplayListCached( const std::string& text );
 
+	// Report the texture memory held by each cached font, and return the total.
+	size_t GetTextureMemoryUsage( FontByteCountMap& fontByteCountMap );
+
+	// These count what a font has done since it was loaded or its counts were last reset.  They cost an increment
+	// here and there, and a clock read per layout, so they are always on.  The last two aren't counts but
+	// how things stand, so resetting leaves them alone.  Draws of compiled static text are counted as display
+	// list calls rather than as the binds and draw calls inside them.
+	struct Stats
+	{
+		uint64_t glyphCacheHits, glyphCacheMisses;
+		uint64_t kerningLookups, kerningCacheMisses;
+		uint64_t glyphsRasterized;
+		uint64_t textureBinds, drawCalls;
+		uint64_t displayListCalls;
+		uint64_t layoutCount;
+		double layoutSeconds;
+		size_t displayListCount;
+		size_t textureByteCount;
+	};
+
+	typedef std::map< std::string, Stats > FontStatsMap;
+
+	// Report the stats of each cached font, and their total in the given stats.
+	void GetStats( Stats& stats, FontStatsMap& fontStatsMap );
+	void ResetStats( void );
+
+	// Each font retains at most the given number of display lists for static text, and at most about the given number
+	// of bytes of them.  The coldest lists are deleted first to make room.  A byte budget of zero retains nothing.
+	void SetRetainedTextLimits( size_t retainedTextMaxCount, size_t retainedTextByteBudget );
+	size_t GetRetainedTextMaxCount( void ) { return retainedTextMaxCount; }
+	size_t GetRetainedTextByteBudget( void ) { return retainedTextByteBudget; }
+
+	// A pinned string is compiled right away, if need be, and is never evicted until it is unpinned or released.
+	bool PinStaticText( const std::string& text, bool pinned = true );
+
+	// Delete the display list of the given string, pinned or not.
+	bool ReleaseStaticText( const std::string& text );
+
+	// Retained text is an alternative to static text that needs no display lists.  The text is laid out now, under the
+	// current font and settings, and its quads go into a vertex buffer that the returned object owns, to be drawn as often
+	// as need be.  Nothing is cached by string, and nothing is evicted: the memory is the object's until it's destroyed.
+	RetainedText* CreateText( const std::string& text );
+	void DestroyText( RetainedText* retainedText );
+
+	// Rasterize the glyphs of the given text, or of the given range of characters, ahead of time at the size
+	// that text would be drawn at now.  This is spread across worker threads, each with its own face, and only
+	// the texture uploads happen on the calling thread.  It's worth doing for large character sets at startup.
+	bool PreloadText( const std::string& text );
+	bool PreloadCharRange( FT_ULong firstCharCode, FT_ULong lastCharCode );
+
+	// This is shared by all fonts of the system.
+	WorkerPool* GetWorkerPool( void );
+
+	// Baked glyph caches are looked for in, and written to, the given directory.  Where one matches a font file, its size
+	// and render mode, glyphs are loaded straight out of it instead of through FreeType.  This should be set before a font
+	// is first used.  An empty directory, the default, turns this off.
+	void SetGlyphCacheDir( const std::string& glyphCacheDir ) { this->glyphCacheDir = glyphCacheDir; }
+	const std::string& GetGlyphCacheDir( void ) { return glyphCacheDir; }
+
+	// Write glyph caches for the given characters of the current font and render mode, one file for each strike.
+	// This doesn't need an OpenGL context.
+	bool BakeGlyphCache( const CharCodeArray& charCodeArray );
+
+	// Start loading the given font, in the current render mode, on a background thread.  The glyphs of the given
+	// characters, or of printable ASCII if none are given, are rasterized there at the size text would be drawn at now.
+	// Their uploads are then left to PumpFontLoads, which should be called once a frame.  Until the font is ready,
+	// drawing with it draws with the fallback font instead, or fails if there is none.  Fonts that were never asked
+	// for this way are still loaded the first time they're drawn with.
+	bool LoadFontAsync( const std::string& font, const CharCodeArray& charCodeArray = CharCodeArray() );
+
+	// Upload glyph images of fonts loaded in the background until the given time is up.  Each font
+	// is ready once all of its images are uploaded.  This must be called with our context bound.
+	void PumpFontLoads( GLfloat budgetMilliseconds );
+
+	bool IsFontReady( const std::string& font );
+
+	// The callback is called from PumpFontLoads as each font finishes loading, or fails to.
+	typedef std::function< void( const std::string& font, bool success ) > FontLoadCallback;
+	void SetFontLoadCallback( const FontLoadCallback& fontLoadCallback ) { this->fontLoadCallback = fontLoadCallback; }
+
+	// This font should already be loaded, or small, as it is loaded the first time it's needed like any other.
+	void SetFallbackFont( const std::string& fallbackFont ) { this->fallbackFont = fallbackFont; }
+	const std::string& GetFallbackFont( void ) { return fallbackFont; }
+
+	// Fonts hold the library lock while they create or destroy faces, since the loader thread may be doing the same.
+	void LockLibrary( void );
+	void UnlockLibrary( void );
+
 	FT_Library& GetLibrary( void ) { return library; }
 	
+	// The given text is taken to be UTF-8, whatever the locale.
 	static std::wstring GetWide( const std::string& text );
+	static void GetWide( const std::string& text, std::wstring& wideText );
 
 private:
 
 	Font* GetOrCreateCachedFont( void );
+	Font* GetOrCreateCachedFont( const std::string& font );
+
+	// Fonts are looked up without locking in a copy of the font map that never changes once published.  A new copy is
+	// published, under the lock, whenever a font is added.  Old copies may still be in use, so they're kept until we're finalized.
+	Font* FindFont( const std::string& key );
+	void PublishFontMap( void );
+	FontMap* GetPublishedFontMap( void );
+	bool PreloadGlyphs( const CharCodeArray& charCodeArray );
 	std::string MakeFontKey( const std::string& font );
 
 	std::string fontBaseDir;
+	std::string glyphCacheDir;
 	std::string font;
 	GLfloat lineWidth, lineHeight;
 	GLfloat baseLineDelta;
 	Justification justification;
 	bool wordWrap;
+	RenderMode renderMode;
+	size_t layoutCacheBudget;
+	size_t retainedTextMaxCount;
+	size_t retainedTextByteBudget;
 	bool initialized;
 	FT_Library library;
 	FontMap fontMap;
+	std::vector< FontMap* > publishedFontMapArray;
+#if defined FONTSYS_THREADS
+	std::atomic< FontMap* > publishedFontMap;
+	std::mutex fontMapMutex;
+	std::mutex libraryMutex;
+#else
+	FontMap* publishedFontMap;
+#endif
+	WorkerPool* workerPool;
+	FontLoader* fontLoader;
+	std::set< std::string > loadingFontKeySet;
+	Font* uploadingFont;
+	std::string uploadingFontName;
+	std::string uploadingFontKey;
+	std::string fallbackFont;
+	FontLoadCallback fontLoadCallback;
+	TextBatch* textBatch;
+	bool batching;
 };
 
 // An instance of this class maintains a means of rendering a cached font using OpenGL.
@@ -114,50 +339,226 @@ class FontSys::Font
 {
 public:
 
-	Font( System* fontSystem );
+	Font( System* fontSystem, System::RenderMode renderMode );
 	virtual ~Font( void );
 
 	virtual bool Initialize( const std::string& font );
+	bool InitializeFile( const std::string& fontFile );
 	virtual bool Finalize( void );
 
 	virtual bool DrawText( const std::string& text, bool staticText = false );
 	virtual bool CalcTextLength( const std::string& text, GLfloat& length );
+	virtual bool MeasureText( const std::string& text, System::TextMetrics& textMetrics );
+
+	// Unlike the rest, these may be called on any number of threads at once, alongside the drawing thread,
+	// with settings of their own.  They aren't counted in the stats.
+	bool CalcTextLength( const std::string& text, GLfloat lineHeight, GLfloat& length );
+	bool MeasureText( const std::string& text, const System::LayoutParams& params, System::TextMetrics& textMetrics );
+	bool CalcTextLengths( const std::vector< std::string >& textArray, GLfloat lineHeight, std::vector< GLfloat >& lengthArray );
+	bool MeasureTexts( const std::vector< std::string >& textArray, const System::LayoutParams& params, std::vector< System::TextMetrics >& textMetricsArray );
+	virtual size_t GetTextureByteCount( void );
+	virtual void GetStats( System::Stats& stats );
+	virtual void ResetStats( void );
+	void AddDrawCalls( unsigned int drawCount );
 	virtual bool DisplayListCached( const std::string& text );
+	virtual bool PinStaticText( const std::string& text, bool pinned );
+	virtual bool ReleaseStaticText( const std::string& text );
+	virtual bool PreloadGlyphs( const CharCodeArray& charCodeArray );
+	virtual bool BakeGlyphCache( const CharCodeArray& charCodeArray );
+
+	// These are for loading in the background.  Glyphs are prepared without touching OpenGL, and can be
+	// on another thread, so long as nothing else is using the font.  Then the images are uploaded one at a time.
+	bool PrepareGlyphs( const CharCodeArray& charCodeArray, GLfloat pixelHeight );
+	bool UploadPendingImage( void );
+
+	// These are for text buffers and documents, which lay out a line at a time.  The line that starts at the given byte
+	// of the text is laid out, and either its quads are added to the quad batch, at the given base line, or its width is
+	// given.  Either way, this gives back where the next line starts.
+	bool FillBufferLine( const std::string& text, size_t begin, const System::LayoutParams& params, GLfloat baseLine, size_t& next );
+	bool MeasureBufferLine( const std::string& text, size_t begin, const System::LayoutParams& params, GLfloat& width, size_t& next );
+
+	// This is for retained text.  The whole text is laid out, just as DrawText would lay it out, and its quads are left
+	// in the quad batch.
+	bool FillText( const std::string& text, const System::LayoutParams& params );
+	QuadBatch* GetQuadBatch( void ) { return quadBatch; }
+	Atlas* GetStrikeAtlas( GLfloat lineHeight );
+	bool IsDistanceField( void ) { return( renderMode == System::RENDER_DISTANCE_FIELD ); }
+
+	// These set up, and then clear, the state it takes to draw from the atlas, just as DrawText does.
+	void BeginDraw( void );
+	void EndDraw( void );
+
+	// This is how many pixels tall the given line height comes out under the current matrices and viewport,
+	// or negative if it can't be told.
+	static GLfloat CalcPixelHeight( GLfloat lineHeight );
 
 private:
 
-	struct GlyphLink
+	// Glyphs are laid out into one flat run that is reused from call to call.
+	struct PlacedGlyph
 	{
 		GLfloat dx, dy;		// Adding this to the previous glyph origin gives us our origin.
 		GLfloat x, y;		// This is the lower-left corner position of the glyph.
 		GLfloat w, h;		// This is the width and height of the glyph.
 		Glyph* glyph;
-		GlyphLink* nextGlyphLink;
 
 		void GetMetrics( FT_Glyph_Metrics& metrics ) const;
 	};
 
-	typedef std::vector< GlyphLink* > GlyphChainVector;
+	typedef std::vector< PlacedGlyph > GlyphRun;
+
+	// A line is a span of the glyph run.
+	struct Line
+	{
+		unsigned int first;
+		unsigned int count;
+	};
+
+	typedef std::vector< Line > LineArray;
+
+	// This is a finished layout: the placed glyphs and how they were broken into lines.  Newlines keep their place in
+	// the run, so that glyphs still line up with characters, but never belong to a line.
+	struct Layout
+	{
+		GlyphRun glyphRun;
+		LineArray lineArray;
+		std::vector< unsigned int > newLineArray;		// These are the indices of the newline glyphs, in order.
+	};
+
+	typedef LruCache< Layout > LayoutCache;
+
+	// Each strike has its own size object on the face and its own atlas, both made when the strike is first drawn.
+	// It may also have a baked glyph cache, which is opened with the font.
+	struct Strike
+	{
+		FT_Size size;
+		Atlas* atlas;
+		GlyphCacheFile* cacheFile;
+	};
+
+	GLfloat CalcConversionFactor( GLfloat lineHeight );
+
+	// The strike is picked by how many pixels tall the text will come out under the current matrices and viewport.
+	int SelectStrike( GLfloat lineHeight );
+	int SelectStrikeForPixelHeight( GLfloat pixelHeight );
+	Strike* GetOrCreateStrike( int strike );
+
+	// With static text, the display list is compiled, and executed only if asked.
+	bool RenderText( const std::string& text, const System::LayoutParams& params, int strike, bool staticText, bool execute );
+	bool BatchText( const std::string& text, const System::LayoutParams& params, int strike, TextBatch* textBatch );
+
+	// The lines of the layout go into the quad batch, rasterizing glyph images as need be.
+	bool FillQuadBatch( const Layout& layout, const System::LayoutParams& params, int strike );
+
+	// The returned layout is either cached or scratch, so it is only good until the next call.
+	const Layout* LayoutText( const std::string& text, const System::LayoutParams& params );
+
+	// These are safe on any thread so long as the layout is the caller's own.  Counts go to the given stats,
+	// which are null off the drawing thread.
+	void BuildLayout( const std::string& text, const System::LayoutParams& params, Layout& layout, System::Stats* stats );
+	GLfloat CalcRunLength( const std::string& text, GLfloat lineHeight, Layout& layout, System::Stats* stats );
+	void FillTextMetrics( const Layout& layout, const System::LayoutParams& params, System::TextMetrics& textMetrics );
+	void LayoutBufferLine( const std::string& text, size_t begin, const System::LayoutParams& params, Line& line, size_t& next );
+
+	// Each worker of the pool lays out in its own scratch layout, and counts in its own stats, which are added to ours
+	// when the jobs are done.  The scratch layouts are kept from call to call, so a steady batch doesn't allocate.
+	typedef std::function< void( Layout& layout, System::Stats& stats, unsigned int index ) > LayoutJob;
+	void RunLayoutJobs( unsigned int count, const LayoutJob& job );
+	static void MakeLayoutKey( const std::string& text, const System::LayoutParams& params, std::string& key );
+	static void MakeDisplayListKey( const std::string& text, const System::LayoutParams& params, int strike, std::string& key );
+
+	void GenerateGlyphRun( const char* text, size_t length, GLfloat conversionFactor, Layout& layout, System::Stats* stats );
+	void KernGlyphRun( GLfloat conversionFactor, Layout& layout, System::Stats* stats );
+	bool RenderLine( const Layout& layout, const Line& line, GLfloat ox, GLfloat oy, GLfloat conversionFactor, int strike );
+	GLfloat CalcLineLength( const Layout& layout, const Line& line );
+	void BreakLines( Layout& layout, const System::LayoutParams& params );
+	unsigned int FindLineBreak( const Layout& layout, unsigned int first, unsigned int end, GLfloat lineWidth );
+	void JustifyLine( Layout& layout, const Line& line, const System::LayoutParams& params );
+	int CountGlyphsInLine( const Layout& layout, const Line& line, FT_ULong charCode );
+
+	// A null glyph is cached for characters the face can't provide.  Only metrics are loaded here.
+	// Glyphs are found without locking, and only created under the face lock, so this is safe on any thread.
+	Glyph* GetOrCreateGlyph( FT_ULong charCode, System::Stats* stats );
+
+	// Glyph images are rasterized the first time they're drawn at a strike, unless they were preloaded.
+	bool RasterizeGlyph( Glyph* glyph, int strike );
+
+	// This is a glyph image rasterized, perhaps off the GL thread, and waiting to go into an atlas.
+	// The buffer is tight, top row first.
+	struct RasterImage
+	{
+		std::vector< GLubyte > buffer;
+		GLuint width, height;
+		FT_Glyph_Metrics metrics;
+	};
+
+	// Faces can't be shared between threads, so each worker opens the font for itself.
+	struct RasterWorker
+	{
+		FT_Library library;
+		FT_Face face;
+		DistanceField* distanceField;
+	};
+
+	// The face must already be at the size of the strike.
+	static bool RasterizeImage( FT_Face face, FT_UInt glyphIndex, DistanceField* distanceField, RasterImage& image );
+	bool CreateGlyphImage( Glyph* glyph, int strike, const RasterImage& image );
 
-	GLfloat CalcConversionFactor( void );
+	// Images are rasterized across the worker pool, and on this thread if need be, but not put into the atlas.
+	void RasterizeImages( const std::vector< Glyph* >& glyphArray, int strike, bool useWorkers, std::vector< RasterImage >& imageArray, std::vector< char >& rasterizedArray );
 
-	GlyphLink* GenerateGlyphChain( const wchar_t* charCodeString, GLfloat conversionFactor );
-	void KernGlyphChain( GlyphLink* glyphLink, GLfloat conversionFactor );
-	void RenderGlyphChain( GlyphLink* glyphLink, GLfloat ox, GLfloat oy );
-	void DeleteGlyphChain( GlyphLink* glyphLink );
-	GLfloat CalcGlyphChainLength( GlyphLink* glyphLink );
-	GlyphLink* BreakGlyphChain( GlyphLink* glyphLink );
-	void JustifyGlyphChain( GlyphLink* glyphLink );
-	int CountGlyphsInChain( GlyphLink* glyphLink, FT_ULong charCode );
+	bool CalcFontHash( void );
+	bool OpenGlyphCacheFiles( void );
+	bool HasCachedGlyphImage( Glyph* glyph, int strike );
+	bool LoadCachedGlyphImage( Glyph* glyph, int strike );
 
-	FT_ULong MakeKerningKey( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex );
+	// Distance fields are only made at the layout size, which is the last strike.
+	int GetFirstStrike( void ) { return renderMode == System::RENDER_DISTANCE_FIELD ? STRIKE_COUNT - 1 : 0; }
+
+	bool OpenRasterWorker( RasterWorker& rasterWorker, int strike );
+	static void CloseRasterWorker( RasterWorker& rasterWorker );
+
+	// Like glyphs, kerning is found without locking, and looked up in the face under the lock.
+	FT_Pos GetKerning( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, System::Stats* stats );
+
+	// The face, and its sizes, can only be used by one thread at a time.  Other threads may be measuring with us.
+	void LockFace( void );
+	void UnlockFace( void );
 
 	bool initialized;
 	System* fontSystem;
+	System::RenderMode renderMode;
+	std::string fontFile;
+	SharedMappedFile* fontData;
+	uint64_t fontHash;
+	FT_Face face;
+	FT_Size layoutSize;
+	Strike strikeArray[ STRIKE_COUNT ];
+	QuadBatch* quadBatch;
+	DistanceField* distanceField;
 	GlyphMap glyphMap;
-	KerningMap kerningMap;
-	TextDisplayListMap textDisplayListMap;
+	LookupTable< Glyph* >* glyphTable;
+	KerningCache* kerningCache;
+	GlyphCacheFile* metricsCacheFile;
+	DisplayListCache* displayListCache;
+	std::string displayListKey;
 	GLuint lineHeightMetric;
+	Layout scratchLayout;
+	RasterImage rasterImage;
+	int pendingStrike;
+	std::vector< Glyph* > pendingCachedGlyphArray;
+	std::vector< Glyph* > pendingGlyphArray;
+	std::vector< RasterImage > pendingImageArray;
+	std::vector< char > pendingRasterizedArray;
+	unsigned int pendingIndex;
+	LayoutCache* layoutCache;
+	std::string layoutKey;
+	std::vector< Layout > workerLayoutArray;
+	std::vector< System::Stats > workerStatsArray;
+	System::Stats stats;
+#if defined FONTSYS_THREADS
+	std::mutex faceMutex;
+#endif
 };
 
 class FontSys::Glyph
@@ -167,17 +568,32 @@ public:
 	Glyph( void );
 	virtual ~Glyph( void );
 
-	bool Initialize( FT_GlyphSlot& glyphSlot, FT_UInt glyphIndex, FT_ULong charCode );
+	// The metrics given here are at the layout size.
+	bool Initialize( const FT_Glyph_Metrics& metrics, FT_UInt glyphIndex, FT_ULong charCode );
 	bool Finalize( void );
 
-	GLuint GetTexture( void ) { return texture; }
+	// This is the glyph as rasterized at one strike, with metrics in that strike's units.
+	// Images without any pixels, such as those of spaces, have a page of -1.
+	struct Image
+	{
+		int page;
+		GLfloat s0, t0, s1, t1;
+		FT_Glyph_Metrics metrics;
+	};
+
+	// The bitmap is an 8-bit gray image, top row first, that the metrics describe.
+	// A failed image is still kept, as an empty one, so that it isn't retried.
+	bool CreateImage( int strike, const FT_Bitmap& bitmap, const FT_Glyph_Metrics& metrics, Atlas* atlas );
+	const Image* GetImage( int strike ) { return imageCreated[ strike ] ? &imageArray[ strike ] : nullptr; }
+
 	const FT_Glyph_Metrics& GetMetrics( void ) { return metrics; }
 	FT_UInt GetIndex( void ) { return glyphIndex; }
 	FT_ULong GetCharCode( void ) { return charCode; }
 
 private:
 
-	GLuint texture;
+	Image imageArray[ STRIKE_COUNT ];
+	bool imageCreated[ STRIKE_COUNT ];
 	FT_Glyph_Metrics metrics;
 	FT_UInt glyphIndex;
 	FT_ULong charCode;
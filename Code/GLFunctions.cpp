@@ -0,0 +1,77 @@
+// GLFunctions.cpp
+
+// Everywhere but Windows, the library exports what the headers declare.
+#if !defined WIN32
+#	define GL_GLEXT_PROTOTYPES
+#endif
+
+#include "GLFunctions.h"
+#include <stdio.h>
+
+using namespace FontSys;
+
+bool GLFunctions::loaded = false;
+
+GLFunctions::GenBuffersProc GLFunctions::GenBuffers = nullptr;
+GLFunctions::DeleteBuffersProc GLFunctions::DeleteBuffers = nullptr;
+GLFunctions::BindBufferProc GLFunctions::BindBuffer = nullptr;
+GLFunctions::BufferDataProc GLFunctions::BufferData = nullptr;
+GLFunctions::BufferSubDataProc GLFunctions::BufferSubData = nullptr;
+
+/*static*/ void GLFunctions::Load( void )
+{
+	if( loaded )
+		return;
+
+	// Without a context, there is no version to go by, so we try again next time.
+	if( !glGetString( GL_VERSION ) )
+		return;
+
+	loaded = true;
+
+	if( HasVersion( 1, 5 ) )
+	{
+#if defined WIN32
+		GenBuffers = ( GenBuffersProc )wglGetProcAddress( "glGenBuffers" );
+		DeleteBuffers = ( DeleteBuffersProc )wglGetProcAddress( "glDeleteBuffers" );
+		BindBuffer = ( BindBufferProc )wglGetProcAddress( "glBindBuffer" );
+		BufferData = ( BufferDataProc )wglGetProcAddress( "glBufferData" );
+		BufferSubData = ( BufferSubDataProc )wglGetProcAddress( "glBufferSubData" );
+#else
+		GenBuffers = ( GenBuffersProc )glGenBuffers;
+		DeleteBuffers = ( DeleteBuffersProc )glDeleteBuffers;
+		BindBuffer = ( BindBufferProc )glBindBuffer;
+		BufferData = ( BufferDataProc )glBufferData;
+		BufferSubData = ( BufferSubDataProc )glBufferSubData;
+#endif
+	}
+
+	// It's all or nothing.
+	if( !GenBuffers || !DeleteBuffers || !BindBuffer || !BufferData || !BufferSubData )
+	{
+		GenBuffers = nullptr;
+		DeleteBuffers = nullptr;
+		BindBuffer = nullptr;
+		BufferData = nullptr;
+		BufferSubData = nullptr;
+	}
+}
+
+/*static*/ bool GLFunctions::HasVersion( int major, int minor )
+{
+	// The version string starts with the major and minor numbers, though some drivers put a word or two first.
+	const char* version = ( const char* )glGetString( GL_VERSION );
+	if( !version )
+		return false;
+
+	while( *version && ( *version < '0' || *version > '9' ) )
+		version++;
+
+	int contextMajor = 0, contextMinor = 0;
+	if( sscanf( version, "%d.%d", &contextMajor, &contextMinor ) != 2 )
+		return false;
+
+	return( contextMajor > major || ( contextMajor == major && contextMinor >= minor ) );
+}
+
+// GLFunctions.cpp
@@ -0,0 +1,51 @@
+// GLFunctions.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include <stddef.h>
+
+#if !defined GL_ARRAY_BUFFER
+#	define GL_ARRAY_BUFFER		0x8892
+#endif
+
+#if !defined GL_DYNAMIC_DRAW
+#	define GL_DYNAMIC_DRAW		0x88E8
+#endif
+
+#if !defined GL_STATIC_DRAW
+#	define GL_STATIC_DRAW		0x88E4
+#endif
+
+// This class looks up the OpenGL entry points we use beyond OpenGL 1.1, which is all that Windows exports.
+// A function is null if the context's version doesn't have it, and whatever uses it must do without.
+class FontSys::GLFunctions
+{
+public:
+
+	// Look everything up, with the context current.  This only does anything the first time.
+	static void Load( void );
+
+	// Buffer objects are core as of OpenGL 1.5.
+	static bool HasBufferObjects( void ) { return( BindBuffer != nullptr ); }
+
+	typedef void ( APIENTRY* GenBuffersProc )( GLsizei count, GLuint* buffers );
+	typedef void ( APIENTRY* DeleteBuffersProc )( GLsizei count, const GLuint* buffers );
+	typedef void ( APIENTRY* BindBufferProc )( GLenum target, GLuint buffer );
+	typedef void ( APIENTRY* BufferDataProc )( GLenum target, ptrdiff_t size, const GLvoid* data, GLenum usage );
+	typedef void ( APIENTRY* BufferSubDataProc )( GLenum target, ptrdiff_t offset, ptrdiff_t size, const GLvoid* data );
+
+	static GenBuffersProc GenBuffers;
+	static DeleteBuffersProc DeleteBuffers;
+	static BindBufferProc BindBuffer;
+	static BufferDataProc BufferData;
+	static BufferSubDataProc BufferSubData;
+
+private:
+
+	static bool HasVersion( int major, int minor );
+
+	static bool loaded;
+};
+
+// GLFunctions.h
@@ -0,0 +1,339 @@
+// GlyphCacheFile.cpp
+
+#include "GlyphCacheFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace FontSys;
+
+static const uint32_t GLYPH_CACHE_MAGIC = 0x43475346;		// "FSGC" when read in little-endian order.
+
+// Bump this whenever the layout of the file or the way its contents are made changes.
+static const uint32_t GLYPH_CACHE_VERSION = 1;
+
+GlyphCacheFile::GlyphCacheFile( void )
+{
+	header = nullptr;
+	glyphRecords = nullptr;
+	glyphIndices = nullptr;
+	kerningRecords = nullptr;
+}
+
+/*virtual*/ GlyphCacheFile::~GlyphCacheFile( void )
+{
+	Close();
+}
+
+/*static*/ bool GlyphCacheFile::HashFontFile( const std::string& path, uint64_t& hash )
+{
+	MappedFile fontFile;
+	if( !fontFile.Open( path ) )
+		return false;
+
+	hash = HashFontData( fontFile.GetData(), fontFile.GetSize() );
+	return true;
+}
+
+/*static*/ uint64_t GlyphCacheFile::HashFontData( const GLubyte* data, size_t size )
+{
+	// This is FNV-1a taken a word at a time, which is plenty to tell font files apart and quick enough to do at every startup.
+	uint64_t hash = 0xCBF29CE484222325ull ^ uint64_t( size );
+
+	size_t i;
+	for( i = 0; i + 8 <= size; i += 8 )
+	{
+		uint64_t word;
+		memcpy( &word, data + i, 8 );
+		hash = ( hash ^ word ) * 0x100000001B3ull;
+		hash ^= hash >> 29;
+	}
+
+	for( ; i < size; i++ )
+		hash = ( hash ^ data[i] ) * 0x100000001B3ull;
+
+	return hash;
+}
+
+/*static*/ std::string GlyphCacheFile::MakeFileName( const Key& key )
+{
+	char fileName[128];
+	sprintf( fileName, "%08x%08x-%u-%s.glyphcache", unsigned( key.fontHash >> 32 ), unsigned( key.fontHash ),
+				unsigned( key.pixelSize ), key.renderMode == System::RENDER_DISTANCE_FIELD ? "sdf" : "coverage" );
+	return fileName;
+}
+
+/*static*/ bool GlyphCacheFile::KeysMatch( const Key& keyA, const Key& keyB )
+{
+	return( keyA.fontHash == keyB.fontHash &&
+			keyA.pixelSize == keyB.pixelSize &&
+			keyA.renderMode == keyB.renderMode &&
+			keyA.layoutPixelSize == keyB.layoutPixelSize &&
+			keyA.fieldScale == keyB.fieldScale &&
+			keyA.fieldSpread == keyB.fieldSpread );
+}
+
+bool GlyphCacheFile::Open( const std::string& path, const Key& key )
+{
+	bool success = false;
+
+	do
+	{
+		if( header )
+			break;
+
+		if( !mappedFile.Open( path ) )
+			break;
+
+		const GLubyte* data = mappedFile.GetData();
+		size_t size = mappedFile.GetSize();
+
+		if( size < sizeof( Header ) )
+			break;
+
+		const Header* fileHeader = ( const Header* )data;
+		if( fileHeader->magic != GLYPH_CACHE_MAGIC || fileHeader->version != GLYPH_CACHE_VERSION )
+			break;
+
+		if( !KeysMatch( fileHeader->key, key ) || fileHeader->fileSize != size )
+			break;
+
+		// Make sure that every table lies within the file, so that nothing we read later can run off the end.
+		if( uint64_t( fileHeader->glyphOffset ) + uint64_t( fileHeader->glyphCount ) * sizeof( GlyphRecord ) > size ||
+			uint64_t( fileHeader->glyphIndexOffset ) + uint64_t( fileHeader->glyphIndexCount ) * sizeof( uint32_t ) > size ||
+			uint64_t( fileHeader->kerningOffset ) + uint64_t( fileHeader->kerningCount ) * sizeof( KerningRecord ) > size )
+			break;
+
+		if( ( fileHeader->glyphOffset | fileHeader->glyphIndexOffset | fileHeader->kerningOffset ) & 3 )
+			break;
+
+		const GlyphRecord* records = ( const GlyphRecord* )( data + fileHeader->glyphOffset );
+
+		uint32_t i;
+		for( i = 0; i < fileHeader->glyphCount; i++ )
+		{
+			const GlyphRecord& record = records[i];
+			if( record.hasImage && uint64_t( record.imageOffset ) + uint64_t( record.imageWidth ) * record.imageHeight > size )
+				break;
+		}
+
+		if( i < fileHeader->glyphCount )
+			break;
+
+		header = fileHeader;
+		glyphRecords = records;
+		glyphIndices = ( const uint32_t* )( data + header->glyphIndexOffset );
+		kerningRecords = ( const KerningRecord* )( data + header->kerningOffset );
+
+		success = true;
+	}
+	while( false );
+
+	if( !success )
+		mappedFile.Close();
+
+	return success;
+}
+
+bool GlyphCacheFile::Close( void )
+{
+	header = nullptr;
+	glyphRecords = nullptr;
+	glyphIndices = nullptr;
+	kerningRecords = nullptr;
+
+	return mappedFile.Close();
+}
+
+const GlyphCacheFile::GlyphRecord* GlyphCacheFile::FindGlyph( FT_ULong charCode )
+{
+	if( !header )
+		return nullptr;
+
+	const GlyphRecord* first = glyphRecords;
+	const GlyphRecord* last = glyphRecords + header->glyphCount;
+
+	while( first < last )
+	{
+		const GlyphRecord* middle = first + ( last - first ) / 2;
+		if( middle->charCode < charCode )
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	if( first == glyphRecords + header->glyphCount || first->charCode != charCode )
+		return nullptr;
+
+	return first;
+}
+
+const GLubyte* GlyphCacheFile::GetImage( const GlyphRecord& glyphRecord )
+{
+	if( !glyphRecord.hasImage || glyphRecord.imageWidth == 0 || glyphRecord.imageHeight == 0 )
+		return nullptr;
+
+	return mappedFile.GetData() + glyphRecord.imageOffset;
+}
+
+bool GlyphCacheFile::FindKerning( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, FT_Pos& kerning )
+{
+	if( !header || !header->kerningComplete )
+		return false;
+
+	// Only pairs of baked glyphs were looked at.
+	const uint32_t* indicesEnd = glyphIndices + header->glyphIndexCount;
+	if( !std::binary_search( glyphIndices, indicesEnd, uint32_t( leftGlyphIndex ) ) ||
+		!std::binary_search( glyphIndices, indicesEnd, uint32_t( rightGlyphIndex ) ) )
+		return false;
+
+	// Pairs without kerning aren't stored.
+	kerning = 0;
+
+	const KerningRecord* first = kerningRecords;
+	const KerningRecord* last = kerningRecords + header->kerningCount;
+
+	while( first < last )
+	{
+		const KerningRecord* middle = first + ( last - first ) / 2;
+		if( middle->leftGlyphIndex < leftGlyphIndex || ( middle->leftGlyphIndex == leftGlyphIndex && middle->rightGlyphIndex < rightGlyphIndex ) )
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	if( first < kerningRecords + header->kerningCount && first->leftGlyphIndex == leftGlyphIndex && first->rightGlyphIndex == rightGlyphIndex )
+		kerning = first->kerning;
+
+	return true;
+}
+
+/*static*/ void GlyphCacheFile::GetMetrics( const int32_t* array, FT_Glyph_Metrics& metrics )
+{
+	metrics.width = array[0];
+	metrics.height = array[1];
+	metrics.horiBearingX = array[2];
+	metrics.horiBearingY = array[3];
+	metrics.horiAdvance = array[4];
+	metrics.vertBearingX = array[5];
+	metrics.vertBearingY = array[6];
+	metrics.vertAdvance = array[7];
+}
+
+/*static*/ void GlyphCacheFile::SetMetrics( const FT_Glyph_Metrics& metrics, int32_t* array )
+{
+	array[0] = int32_t( metrics.width );
+	array[1] = int32_t( metrics.height );
+	array[2] = int32_t( metrics.horiBearingX );
+	array[3] = int32_t( metrics.horiBearingY );
+	array[4] = int32_t( metrics.horiAdvance );
+	array[5] = int32_t( metrics.vertBearingX );
+	array[6] = int32_t( metrics.vertBearingY );
+	array[7] = int32_t( metrics.vertAdvance );
+}
+
+/*static*/ bool GlyphCacheFile::Write( const std::string& path, const Key& key, GlyphRecordArray& glyphRecordArray, const ImageArray& imageArray,
+										const KerningRecordArray& kerningRecordArray, bool kerningComplete )
+{
+	bool success = false;
+	FILE* file = nullptr;
+	std::string tempPath = path + ".tmp";
+
+	do
+	{
+		std::vector< uint32_t > glyphIndexArray;
+		for( unsigned int i = 0; i < glyphRecordArray.size(); i++ )
+			glyphIndexArray.push_back( glyphRecordArray[i].glyphIndex );
+
+		std::sort( glyphIndexArray.begin(), glyphIndexArray.end() );
+		glyphIndexArray.erase( std::unique( glyphIndexArray.begin(), glyphIndexArray.end() ), glyphIndexArray.end() );
+
+		Header fileHeader;
+		memset( &fileHeader, 0, sizeof( Header ) );
+		fileHeader.magic = GLYPH_CACHE_MAGIC;
+		fileHeader.version = GLYPH_CACHE_VERSION;
+		fileHeader.key = key;
+		fileHeader.glyphCount = uint32_t( glyphRecordArray.size() );
+		fileHeader.glyphOffset = sizeof( Header );
+		fileHeader.glyphIndexCount = uint32_t( glyphIndexArray.size() );
+		fileHeader.glyphIndexOffset = fileHeader.glyphOffset + fileHeader.glyphCount * sizeof( GlyphRecord );
+		fileHeader.kerningCount = uint32_t( kerningRecordArray.size() );
+		fileHeader.kerningOffset = fileHeader.glyphIndexOffset + fileHeader.glyphIndexCount * sizeof( uint32_t );
+		fileHeader.kerningComplete = kerningComplete ? 1 : 0;
+
+		// Images follow the tables, each starting on a 4-byte boundary.
+		uint64_t offset = fileHeader.kerningOffset + uint64_t( fileHeader.kerningCount ) * sizeof( KerningRecord );
+		for( unsigned int i = 0; i < glyphRecordArray.size(); i++ )
+		{
+			GlyphRecord& record = glyphRecordArray[i];
+			record.imageOffset = 0;
+			if( imageArray[i] )
+			{
+				record.imageOffset = uint32_t( offset );
+				offset += ( uint64_t( record.imageWidth ) * record.imageHeight + 3 ) & ~uint64_t(3);
+			}
+		}
+
+		if( offset > 0xFFFFFFFFull )
+			break;
+
+		fileHeader.fileSize = uint32_t( offset );
+
+		file = fopen( tempPath.c_str(), "wb" );
+		if( !file )
+			break;
+
+		bool written = fwrite( &fileHeader, sizeof( Header ), 1, file ) == 1;
+
+		if( written && glyphRecordArray.size() > 0 )
+			written = fwrite( &glyphRecordArray[0], sizeof( GlyphRecord ), glyphRecordArray.size(), file ) == glyphRecordArray.size();
+
+		if( written && glyphIndexArray.size() > 0 )
+			written = fwrite( &glyphIndexArray[0], sizeof( uint32_t ), glyphIndexArray.size(), file ) == glyphIndexArray.size();
+
+		if( written && kerningRecordArray.size() > 0 )
+			written = fwrite( &kerningRecordArray[0], sizeof( KerningRecord ), kerningRecordArray.size(), file ) == kerningRecordArray.size();
+
+		static const GLubyte padding[4] = { 0, 0, 0, 0 };
+
+		for( unsigned int i = 0; written && i < glyphRecordArray.size(); i++ )
+		{
+			if( !imageArray[i] )
+				continue;
+
+			const GlyphRecord& record = glyphRecordArray[i];
+			size_t imageSize = size_t( record.imageWidth ) * record.imageHeight;
+			written = fwrite( imageArray[i], 1, imageSize, file ) == imageSize;
+
+			size_t paddingSize = ( 4 - ( imageSize & 3 ) ) & 3;
+			if( written && paddingSize > 0 )
+				written = fwrite( padding, 1, paddingSize, file ) == paddingSize;
+		}
+
+		if( fclose( file ) != 0 )
+			written = false;
+
+		file = nullptr;
+
+		if( !written )
+			break;
+
+		// Renaming doesn't replace an existing file everywhere, so get it out of the way first.
+		remove( path.c_str() );
+		if( rename( tempPath.c_str(), path.c_str() ) != 0 )
+			break;
+
+		success = true;
+	}
+	while( false );
+
+	if( file )
+		fclose( file );
+
+	if( !success )
+		remove( tempPath.c_str() );
+
+	return success;
+}
+
+// GlyphCacheFile.cpp
@@ -0,0 +1,104 @@
+// GlyphCacheFile.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include "MappedFile.h"
+#include <stdint.h>
+
+// An instance of this class reads a baked glyph cache, which holds everything FreeType would otherwise have
+// to work out for a set of characters: glyph indices and layout metrics, kerning, and the rasterized images
+// of one strike.  The file is memory-mapped and used in place.  Each file is for one font file, strike and
+// render mode, and is ignored unless its key and format version match exactly.  Numbers are in native byte order.
+class FontSys::GlyphCacheFile
+{
+public:
+
+	GlyphCacheFile( void );
+	virtual ~GlyphCacheFile( void );
+
+	// This says what a file was baked from and with which settings.
+	struct Key
+	{
+		uint64_t fontHash;
+		uint32_t pixelSize;
+		uint32_t renderMode;
+		uint32_t layoutPixelSize;
+		uint32_t fieldScale;
+		uint32_t fieldSpread;
+	};
+
+	// Metrics are stored as 32-bit integers in the order of FT_Glyph_Metrics.
+	struct GlyphRecord
+	{
+		uint32_t charCode;
+		uint32_t glyphIndex;
+		int32_t metrics[8];			// These are at the layout size.
+		int32_t imageMetrics[8];	// These are in the units of the strike.
+		uint32_t imageWidth;
+		uint32_t imageHeight;
+		uint32_t imageOffset;		// The image is tight, top row first, at this offset from the start of the file.
+		uint32_t hasImage;			// This is zero if the glyph couldn't be rasterized.  Spaces have an image with no pixels.
+	};
+
+	struct KerningRecord
+	{
+		uint32_t leftGlyphIndex;
+		uint32_t rightGlyphIndex;
+		int32_t kerning;
+	};
+
+	typedef std::vector< GlyphRecord > GlyphRecordArray;
+	typedef std::vector< KerningRecord > KerningRecordArray;
+	typedef std::vector< const GLubyte* > ImageArray;
+
+	static bool HashFontFile( const std::string& path, uint64_t& hash );
+	static uint64_t HashFontData( const GLubyte* data, size_t size );
+	static std::string MakeFileName( const Key& key );
+
+	bool Open( const std::string& path, const Key& key );
+	bool Close( void );
+
+	const GlyphRecord* FindGlyph( FT_ULong charCode );
+	const GLubyte* GetImage( const GlyphRecord& glyphRecord );
+
+	// Return true if the file knows the kerning of the pair, which it does for every pair of baked glyphs
+	// unless there were too many of them to bake it all.
+	bool FindKerning( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, FT_Pos& kerning );
+
+	static void GetMetrics( const int32_t* array, FT_Glyph_Metrics& metrics );
+	static void SetMetrics( const FT_Glyph_Metrics& metrics, int32_t* array );
+
+	// The glyph records must be sorted by character, and the kerning records by pair.  Each glyph that
+	// has an image with pixels has them in the image array at the same index.  The file is written whole
+	// under a temporary name and then renamed, so that a reader never sees it half written.
+	static bool Write( const std::string& path, const Key& key, GlyphRecordArray& glyphRecordArray, const ImageArray& imageArray,
+						const KerningRecordArray& kerningRecordArray, bool kerningComplete );
+
+private:
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		Key key;
+		uint32_t glyphCount;
+		uint32_t glyphOffset;
+		uint32_t glyphIndexCount;
+		uint32_t glyphIndexOffset;
+		uint32_t kerningCount;
+		uint32_t kerningOffset;
+		uint32_t kerningComplete;
+		uint32_t fileSize;
+	};
+
+	static bool KeysMatch( const Key& keyA, const Key& keyB );
+
+	MappedFile mappedFile;
+	const Header* header;
+	const GlyphRecord* glyphRecords;
+	const uint32_t* glyphIndices;
+	const KerningRecord* kerningRecords;
+};
+
+// GlyphCacheFile.h
@@ -0,0 +1,38 @@
+// KerningCache.cpp
+
+#include "KerningCache.h"
+
+using namespace FontSys;
+
+KerningCache::KerningCache( void )
+{
+}
+
+/*virtual*/ KerningCache::~KerningCache( void )
+{
+}
+
+void KerningCache::Clear( void )
+{
+	table.Clear();
+}
+
+/*static*/ uint64_t KerningCache::MakeKey( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex )
+{
+	uint64_t left = leftGlyphIndex;
+	uint64_t right = rightGlyphIndex;
+
+	return( ( left << 32 ) | right );
+}
+
+bool KerningCache::Lookup( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, FT_Pos& kerning )
+{
+	return table.Find( MakeKey( leftGlyphIndex, rightGlyphIndex ), kerning );
+}
+
+void KerningCache::Insert( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, FT_Pos kerning )
+{
+	table.Insert( MakeKey( leftGlyphIndex, rightGlyphIndex ), kerning );
+}
+
+// KerningCache.cpp
@@ -0,0 +1,36 @@
+// KerningCache.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include "LookupTable.h"
+#include <stdint.h>
+
+// An instance of this class remembers kerning adjustments by glyph-index pair.
+// It is an open-addressing hash table with linear probing, so a lookup is a
+// handful of probes into one flat array and never allocates.  Lookups don't lock,
+// and may happen on any number of threads, but inserts must be made one at a time.
+class FontSys::KerningCache
+{
+public:
+
+	KerningCache( void );
+	virtual ~KerningCache( void );
+
+	void Clear( void );
+
+	// Return true and the adjustment if the pair has been recorded.
+	bool Lookup( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, FT_Pos& kerning );
+	void Insert( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex, FT_Pos kerning );
+
+	unsigned int GetCount( void ) { return table.GetCount(); }
+
+private:
+
+	// Glyph zero is never kerned, so no pair has a key of zero.
+	static uint64_t MakeKey( FT_UInt leftGlyphIndex, FT_UInt rightGlyphIndex );
+
+	LookupTable< FT_Pos > table;
+};
+
+// KerningCache.h
@@ -0,0 +1,187 @@
+// LookupTable.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include <stdint.h>
+
+// An instance of this class maps nonzero 64-bit keys to values by open addressing with linear probing.
+// Any number of threads may look up at once, without locking, while inserts are made one at a time.
+// An entry's value is written before its key, so a reader that finds the key finds the value with it.
+// A table that fills up is copied into one twice the size and swapped in whole.  The old one is kept
+// until we're cleared, so that a reader still probing it is never left with freed memory.  Values must be
+// types that std::atomic holds without a lock, such as pointers and integers.
+template< typename Value >
+class FontSys::LookupTable
+{
+public:
+
+	LookupTable( void )
+	{
+		StoreTable( nullptr );
+		count = 0;
+	}
+
+	virtual ~LookupTable( void )
+	{
+		Clear();
+	}
+
+	// This must not overlap with anything else.
+	void Clear( void )
+	{
+		StoreTable( nullptr );
+		count = 0;
+
+		for( unsigned int i = 0; i < tableArray.size(); i++ )
+		{
+			delete[] tableArray[i]->slotArray;
+			delete tableArray[i];
+		}
+
+		tableArray.clear();
+	}
+
+	// Return true and the value if the key has been inserted.
+	bool Find( uint64_t key, Value& value ) const
+	{
+		const Table* table = LoadTable();
+		if( !table )
+			return false;
+
+		for( unsigned int i = Hash( key ) & table->mask; true; i = ( i + 1 ) & table->mask )
+		{
+			const Slot& slot = table->slotArray[i];
+			uint64_t slotKey = LoadKey( slot );
+
+			if( slotKey == key )
+			{
+				value = LoadValue( slot );
+				return true;
+			}
+
+			if( slotKey == 0 )
+				return false;
+		}
+	}
+
+	// The caller must see to it that no other insert happens at the same time.
+	void Insert( uint64_t key, Value value )
+	{
+		if( key == 0 )
+			return;
+
+		Table* table = LoadTable();
+		if( !table || 2 * ( count + 1 ) > table->mask + 1 )
+			table = Grow( table );
+
+		if( Place( table, key, value ) )
+			count++;
+	}
+
+	unsigned int GetCount( void ) { return count; }
+
+private:
+
+	struct Slot
+	{
+#if defined FONTSYS_THREADS
+		std::atomic< uint64_t > key;
+		std::atomic< Value > value;
+#else
+		uint64_t key;
+		Value value;
+#endif
+	};
+
+	struct Table
+	{
+		unsigned int mask;
+		Slot* slotArray;
+	};
+
+	static unsigned int Hash( uint64_t key )
+	{
+		// Fibonacci hashing spreads neighboring keys across the table.
+		key *= 0x9E3779B97F4A7C15ull;
+		return unsigned( key >> 32 );
+	}
+
+#if defined FONTSYS_THREADS
+	static uint64_t LoadKey( const Slot& slot ) { return slot.key.load( std::memory_order_acquire ); }
+	static Value LoadValue( const Slot& slot ) { return slot.value.load( std::memory_order_relaxed ); }
+	static void StoreKey( Slot& slot, uint64_t key ) { slot.key.store( key, std::memory_order_release ); }
+	static void StoreValue( Slot& slot, Value value ) { slot.value.store( value, std::memory_order_relaxed ); }
+	Table* LoadTable( void ) const { return currentTable.load( std::memory_order_acquire ); }
+	void StoreTable( Table* table ) { currentTable.store( table, std::memory_order_release ); }
+#else
+	static uint64_t LoadKey( const Slot& slot ) { return slot.key; }
+	static Value LoadValue( const Slot& slot ) { return slot.value; }
+	static void StoreKey( Slot& slot, uint64_t key ) { slot.key = key; }
+	static void StoreValue( Slot& slot, Value value ) { slot.value = value; }
+	Table* LoadTable( void ) const { return currentTable; }
+	void StoreTable( Table* table ) { currentTable = table; }
+#endif
+
+	// Return true if the key is new to the table.
+	static bool Place( Table* table, uint64_t key, Value value )
+	{
+		for( unsigned int i = Hash( key ) & table->mask; true; i = ( i + 1 ) & table->mask )
+		{
+			Slot& slot = table->slotArray[i];
+			uint64_t slotKey = LoadKey( slot );
+
+			if( slotKey == key )
+			{
+				StoreValue( slot, value );
+				return false;
+			}
+
+			if( slotKey == 0 )
+			{
+				StoreValue( slot, value );
+				StoreKey( slot, key );
+				return true;
+			}
+		}
+	}
+
+	Table* Grow( Table* oldTable )
+	{
+		// The size must stay a power of two for the masking to work.
+		unsigned int size = oldTable ? 2 * ( oldTable->mask + 1 ) : 256;
+
+		Table* table = new Table;
+		table->mask = size - 1;
+		table->slotArray = new Slot[ size ];
+
+		for( unsigned int i = 0; i < size; i++ )
+			StoreKey( table->slotArray[i], 0 );
+
+		if( oldTable )
+		{
+			for( unsigned int i = 0; i <= oldTable->mask; i++ )
+			{
+				const Slot& slot = oldTable->slotArray[i];
+				uint64_t key = LoadKey( slot );
+				if( key != 0 )
+					Place( table, key, LoadValue( slot ) );
+			}
+		}
+
+		tableArray.push_back( table );
+		StoreTable( table );
+
+		return table;
+	}
+
+#if defined FONTSYS_THREADS
+	std::atomic< Table* > currentTable;
+#else
+	Table* currentTable;
+#endif
+	std::vector< Table* > tableArray;
+	unsigned int count;
+};
+
+// LookupTable.h
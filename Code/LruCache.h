@@ -0,0 +1,162 @@
+// LruCache.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include <list>
+#include <unordered_map>
+
+// An instance of this class maps string keys to values while keeping the total
+// size of what it holds under a byte budget and, optionally, an entry count.
+// When either limit would be exceeded, the least recently used entries are evicted
+// first.  Pinned entries are never evicted, but still count against the limits.
+// A byte budget of zero disables the cache.
+template< typename Value >
+class FontSys::LruCache
+{
+public:
+
+	LruCache( void )
+	{
+		byteBudget = 0;
+		maxCount = 0;
+		byteCount = 0;
+	}
+
+	// Note that we can't discard from here, so owners with resources to free must clear us themselves.
+	virtual ~LruCache( void )
+	{
+	}
+
+	// A maximum count of zero means that the number of entries is unlimited.
+	void SetLimits( size_t byteBudget, size_t maxCount )
+	{
+		this->byteBudget = byteBudget;
+		this->maxCount = maxCount;
+		MakeRoom( 0, 0 );
+	}
+
+	size_t GetByteBudget( void ) { return byteBudget; }
+	size_t GetMaxCount( void ) { return maxCount; }
+	size_t GetByteCount( void ) { return byteCount; }
+	size_t GetCount( void ) { return entryList.size(); }
+
+	// A hit makes the entry the most recently used.
+	Value* Find( const std::string& key )
+	{
+		typename EntryMap::iterator iter = entryMap.find( key );
+		if( iter == entryMap.end() )
+			return nullptr;
+
+		entryList.splice( entryList.begin(), entryList, iter->second );
+		return &iter->second->value;
+	}
+
+	// The returned value is left for the caller to fill in; it stays valid until it is evicted.
+	// The given size should account for everything the value owns.  Nothing is inserted if room can't be made.
+	Value* Insert( const std::string& key, size_t bytes )
+	{
+		Remove( key );
+
+		if( !MakeRoom( bytes, 1 ) )
+			return nullptr;
+
+		entryList.push_front( Entry() );
+		Entry& entry = entryList.front();
+		entry.key = key;
+		entry.bytes = bytes;
+		entry.pinned = false;
+
+		entryMap[ key ] = entryList.begin();
+		byteCount += bytes;
+
+		return &entry.value;
+	}
+
+	bool Pin( const std::string& key, bool pinned )
+	{
+		typename EntryMap::iterator iter = entryMap.find( key );
+		if( iter == entryMap.end() )
+			return false;
+
+		iter->second->pinned = pinned;
+		return true;
+	}
+
+	// Pinned or not, the entry goes.
+	bool Remove( const std::string& key )
+	{
+		typename EntryMap::iterator iter = entryMap.find( key );
+		if( iter == entryMap.end() )
+			return false;
+
+		Erase( iter->second );
+		return true;
+	}
+
+	void Clear( void )
+	{
+		while( entryList.size() > 0 )
+			Erase( entryList.begin() );
+	}
+
+protected:
+
+	// Override this to free whatever a value holds as it leaves the cache.
+	virtual void Discard( Value& /*value*/ )
+	{
+	}
+
+private:
+
+	struct Entry
+	{
+		std::string key;
+		size_t bytes;
+		bool pinned;
+		Value value;
+	};
+
+	typedef std::list< Entry > EntryList;
+	typedef std::unordered_map< std::string, typename EntryList::iterator > EntryMap;
+
+	void Erase( typename EntryList::iterator iter )
+	{
+		Discard( iter->value );
+		byteCount -= iter->bytes;
+		entryMap.erase( iter->key );
+		entryList.erase( iter );
+	}
+
+	// Evict the coldest unpinned entries until the given number of bytes and entries would fit.
+	bool MakeRoom( size_t bytes, size_t count )
+	{
+		if( bytes > byteBudget )
+			return false;
+
+		typename EntryList::iterator iter = entryList.end();
+
+		while( byteCount + bytes > byteBudget || ( maxCount > 0 && entryList.size() + count > maxCount ) )
+		{
+			if( iter == entryList.begin() )
+				return false;
+
+			typename EntryList::iterator evictIter = --iter;
+			if( evictIter->pinned )
+				continue;
+
+			iter++;
+			Erase( evictIter );
+		}
+
+		return true;
+	}
+
+	EntryList entryList;
+	EntryMap entryMap;
+	size_t byteBudget;
+	size_t maxCount;
+	size_t byteCount;
+};
+
+// LruCache.h
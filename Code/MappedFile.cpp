@@ -0,0 +1,138 @@
+// MappedFile.cpp
+
+#include "MappedFile.h"
+#if !defined WIN32
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+using namespace FontSys;
+
+MappedFile::MappedFile( void )
+{
+	data = nullptr;
+	size = 0;
+
+#if defined WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#endif
+}
+
+/*virtual*/ MappedFile::~MappedFile( void )
+{
+	Close();
+}
+
+#if defined WIN32
+
+bool MappedFile::Open( const std::string& path )
+{
+	bool success = false;
+
+	do
+	{
+		if( data )
+			break;
+
+		fileHandle = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+		if( fileHandle == INVALID_HANDLE_VALUE )
+			break;
+
+		LARGE_INTEGER fileSize;
+		if( !GetFileSizeEx( fileHandle, &fileSize ) || fileSize.QuadPart == 0 )
+			break;
+
+		mappingHandle = CreateFileMappingA( fileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+		if( mappingHandle == NULL )
+			break;
+
+		data = ( const GLubyte* )MapViewOfFile( mappingHandle, FILE_MAP_READ, 0, 0, 0 );
+		if( !data )
+			break;
+
+		size = size_t( fileSize.QuadPart );
+
+		success = true;
+	}
+	while( false );
+
+	if( !success )
+		Close();
+
+	return success;
+}
+
+bool MappedFile::Close( void )
+{
+	if( data )
+		UnmapViewOfFile( data );
+
+	if( mappingHandle != NULL )
+		CloseHandle( mappingHandle );
+
+	if( fileHandle != INVALID_HANDLE_VALUE )
+		CloseHandle( fileHandle );
+
+	data = nullptr;
+	size = 0;
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+
+	return true;
+}
+
+#else //WIN32
+
+bool MappedFile::Open( const std::string& path )
+{
+	bool success = false;
+	int fileDescriptor = -1;
+
+	do
+	{
+		if( data )
+			break;
+
+		fileDescriptor = open( path.c_str(), O_RDONLY );
+		if( fileDescriptor < 0 )
+			break;
+
+		struct stat fileStat;
+		if( fstat( fileDescriptor, &fileStat ) != 0 || fileStat.st_size == 0 )
+			break;
+
+		void* mapping = mmap( nullptr, size_t( fileStat.st_size ), PROT_READ, MAP_SHARED, fileDescriptor, 0 );
+		if( mapping == MAP_FAILED )
+			break;
+
+		data = ( const GLubyte* )mapping;
+		size = size_t( fileStat.st_size );
+
+		success = true;
+	}
+	while( false );
+
+	// The mapping outlives the descriptor.
+	if( fileDescriptor >= 0 )
+		close( fileDescriptor );
+
+	return success;
+}
+
+bool MappedFile::Close( void )
+{
+	if( data )
+		munmap( ( void* )data, size );
+
+	data = nullptr;
+	size = 0;
+
+	return true;
+}
+
+#endif //WIN32
+
+// MappedFile.cpp
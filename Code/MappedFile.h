@@ -0,0 +1,33 @@
+// MappedFile.h
+
+#pragma once
+
+#include "FontSystem.h"
+
+// An instance of this class maps a whole file read-only into memory.
+class FontSys::MappedFile
+{
+public:
+
+	MappedFile( void );
+	virtual ~MappedFile( void );
+
+	bool Open( const std::string& path );
+	bool Close( void );
+
+	bool IsOpen( void ) { return data != nullptr; }
+	const GLubyte* GetData( void ) { return data; }
+	size_t GetSize( void ) { return size; }
+
+private:
+
+	const GLubyte* data;
+	size_t size;
+
+#if defined WIN32
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+#endif
+};
+
+// MappedFile.h
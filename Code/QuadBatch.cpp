@@ -0,0 +1,151 @@
+// QuadBatch.cpp
+
+#include "QuadBatch.h"
+#include "Atlas.h"
+#include "GLFunctions.h"
+
+using namespace FontSys;
+
+QuadBatch::QuadBatch( void )
+{
+}
+
+/*virtual*/ QuadBatch::~QuadBatch( void )
+{
+}
+
+void QuadBatch::Clear( void )
+{
+	// Note that clearing a vector keeps its capacity.
+	for( unsigned int i = 0; i < pageVertexArray.size(); i++ )
+		pageVertexArray[i].clear();
+}
+
+bool QuadBatch::IsEmpty( void )
+{
+	for( unsigned int i = 0; i < pageVertexArray.size(); i++ )
+		if( pageVertexArray[i].size() > 0 )
+			return false;
+
+	return true;
+}
+
+unsigned int QuadBatch::GetVertexCount( void )
+{
+	unsigned int vertexCount = 0;
+
+	for( unsigned int i = 0; i < pageVertexArray.size(); i++ )
+		vertexCount += unsigned( pageVertexArray[i].size() );
+
+	return vertexCount;
+}
+
+// This is the number of pages with something to draw, which is how many draw calls we'll make.
+unsigned int QuadBatch::GetPageCount( void )
+{
+	unsigned int pageCount = 0;
+
+	for( unsigned int i = 0; i < pageVertexArray.size(); i++ )
+		if( pageVertexArray[i].size() > 0 )
+			pageCount++;
+
+	return pageCount;
+}
+
+void QuadBatch::AddQuad( int page, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, GLfloat s0, GLfloat t0, GLfloat s1, GLfloat t1 )
+{
+	if( page < 0 )
+		return;
+
+	if( unsigned( page ) >= pageVertexArray.size() )
+		pageVertexArray.resize( page + 1 );
+
+	VertexArray& vertexArray = pageVertexArray[ page ];
+
+	Vertex vertex;
+
+	vertex.x = x0;	vertex.y = y0;	vertex.s = s0;	vertex.t = t0;	vertexArray.push_back( vertex );
+	vertex.x = x1;	vertex.y = y0;	vertex.s = s1;	vertex.t = t0;	vertexArray.push_back( vertex );
+	vertex.x = x1;	vertex.y = y1;	vertex.s = s1;	vertex.t = t1;	vertexArray.push_back( vertex );
+	vertex.x = x0;	vertex.y = y1;	vertex.s = s0;	vertex.t = t1;	vertexArray.push_back( vertex );
+}
+
+unsigned int QuadBatch::Draw( Atlas* atlas )
+{
+	unsigned int drawCount = 0;
+
+	// Leave the caller's array state as we found it.
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+	for( unsigned int i = 0; i < pageVertexArray.size(); i++ )
+	{
+		VertexArray& vertexArray = pageVertexArray[i];
+		if( vertexArray.size() == 0 || int( i ) >= atlas->GetPageCount() )
+			continue;
+
+		glBindTexture( GL_TEXTURE_2D, atlas->GetPageTexture(i) );
+
+		glVertexPointer( 2, GL_FLOAT, sizeof( Vertex ), &vertexArray[0].x );
+		glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ), &vertexArray[0].s );
+
+		glDrawArrays( GL_QUADS, 0, GLsizei( vertexArray.size() ) );
+		drawCount++;
+	}
+
+	glPopClientAttrib();
+
+	return drawCount;
+}
+
+/*static*/ unsigned int QuadBatch::DrawRanges( Atlas* atlas, GLuint vertexBuffer, const VertexArray& vertexArray, const RangeArray& rangeArray )
+{
+	if( vertexBuffer == 0 && vertexArray.size() == 0 )
+		return 0;
+
+	unsigned int drawCount = 0;
+
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+	// With a buffer object bound, the pointers are offsets into it.
+	const GLubyte* base = nullptr;
+	if( vertexBuffer != 0 )
+		GLFunctions::BindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+	else
+		base = ( const GLubyte* )&vertexArray[0];
+
+	glVertexPointer( 2, GL_FLOAT, sizeof( Vertex ), base + offsetof( Vertex, x ) );
+	glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ), base + offsetof( Vertex, s ) );
+
+	int boundPage = -1;
+
+	for( unsigned int i = 0; i < rangeArray.size(); i++ )
+	{
+		const Range& range = rangeArray[i];
+		if( range.page >= atlas->GetPageCount() )
+			continue;
+
+		if( range.page != boundPage )
+		{
+			glBindTexture( GL_TEXTURE_2D, atlas->GetPageTexture( range.page ) );
+			boundPage = range.page;
+		}
+
+		glDrawArrays( GL_QUADS, range.first, range.count );
+		drawCount++;
+	}
+
+	if( vertexBuffer != 0 )
+		GLFunctions::BindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glPopClientAttrib();
+
+	return drawCount;
+}
+
+// QuadBatch.cpp
@@ -0,0 +1,62 @@
+// QuadBatch.h
+
+#pragma once
+
+#include "FontSystem.h"
+
+// An instance of this class collects textured quads into client-side vertex arrays,
+// one array per atlas page, so that they can be submitted with a single draw call per page.
+// The arrays are kept between uses so that steady-state drawing does not allocate.
+class FontSys::QuadBatch
+{
+public:
+
+	QuadBatch( void );
+	virtual ~QuadBatch( void );
+
+	struct Vertex
+	{
+		GLfloat x, y;
+		GLfloat s, t;
+	};
+
+	typedef std::vector< Vertex > VertexArray;
+
+	void Clear( void );
+	bool IsEmpty( void );
+	unsigned int GetVertexCount( void );
+	unsigned int GetPageCount( void );
+
+	// Pages are numbered from zero up to, but not including, the limit.  Some may have no quads.
+	unsigned int GetPageLimit( void ) { return unsigned( pageVertexArray.size() ); }
+	const VertexArray& GetPageVertexArray( unsigned int page ) { return pageVertexArray[ page ]; }
+
+	// The quad spans the given lower-left and upper-right corners in both object and texture space.
+	void AddQuad( int page, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, GLfloat s0, GLfloat t0, GLfloat s1, GLfloat t1 );
+
+	// Here we assume that texturing is already setup.  Nothing is cleared.
+	// This returns the number of draw calls made, each after binding its page.
+	unsigned int Draw( Atlas* atlas );
+
+	// Vertex data kept elsewhere, as by text buffers and retained text, is drawn by ranges, each from one page.
+	struct Range
+	{
+		int page;
+		GLint first;
+		GLsizei count;
+	};
+
+	typedef std::vector< Range > RangeArray;
+
+	// The vertices come from the given buffer object, or from the given array if there's none.  A page is only bound
+	// when it differs from the last range's, so ranges should be sorted by page.  This returns the number of draw calls.
+	static unsigned int DrawRanges( Atlas* atlas, GLuint vertexBuffer, const VertexArray& vertexArray, const RangeArray& rangeArray );
+
+private:
+
+	typedef std::vector< VertexArray > PageVertexArray;
+
+	PageVertexArray pageVertexArray;
+};
+
+// QuadBatch.h
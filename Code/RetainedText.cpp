@@ -0,0 +1,147 @@
+// RetainedText.cpp
+
+#include "RetainedText.h"
+#include "TextBatch.h"
+#include "Atlas.h"
+#include "GLFunctions.h"
+
+using namespace FontSys;
+
+RetainedText::RetainedText( System* fontSystem, Font* font, const System::LayoutParams& params, const std::string& text )
+{
+	this->fontSystem = fontSystem;
+	this->font = font;
+	this->params = params;
+	this->text = text;
+	atlasSerial = 0;
+	vertexBuffer = 0;
+	buildCount = 0;
+}
+
+/*virtual*/ RetainedText::~RetainedText( void )
+{
+	if( vertexBuffer != 0 && GLFunctions::HasBufferObjects() )
+		GLFunctions::DeleteBuffers( 1, &vertexBuffer );
+}
+
+bool RetainedText::Draw( GLfloat x, GLfloat y )
+{
+	glPushMatrix();
+	glTranslatef( x, y, 0.f );
+
+	bool success = Draw();
+
+	glPopMatrix();
+
+	return success;
+}
+
+bool RetainedText::Draw( void )
+{
+	// The atlas is picked by how big the text comes out on screen, so it can change from one draw to the next.
+	Atlas* atlas = font->GetStrikeAtlas( params.lineHeight );
+	if( !atlas )
+		return false;
+
+	if( buildCount == 0 || atlas->GetSerial() != atlasSerial )
+	{
+		if( !Build( atlas ) )
+			return false;
+	}
+
+	if( vertexArray.size() == 0 )
+		return true;
+
+	TextBatch* textBatch = fontSystem->GetTextBatch();
+	if( textBatch )
+	{
+		GLfloat matrix[16];
+		glGetFloatv( GL_MODELVIEW_MATRIX, matrix );
+
+		GLfloat color[4];
+		glGetFloatv( GL_CURRENT_COLOR, color );
+
+		for( unsigned int i = 0; i < rangeArray.size(); i++ )
+		{
+			const QuadBatch::Range& range = rangeArray[i];
+			textBatch->AddPageQuads( font, atlas, font->IsDistanceField(), range.page, &vertexArray[ range.first ], unsigned( range.count ), matrix, color );
+		}
+
+		return true;
+	}
+
+	font->BeginDraw();
+	font->AddDrawCalls( QuadBatch::DrawRanges( atlas, vertexBuffer, vertexArray, rangeArray ) );
+	font->EndDraw();
+
+	return true;
+}
+
+bool RetainedText::Build( void )
+{
+	Atlas* atlas = font->GetStrikeAtlas( params.lineHeight );
+	if( !atlas )
+		return false;
+
+	return Build( atlas );
+}
+
+size_t RetainedText::GetByteCount( void )
+{
+	size_t byteCount = vertexArray.size() * sizeof( QuadBatch::Vertex );
+	return( vertexBuffer != 0 ? 2 * byteCount : byteCount );
+}
+
+bool RetainedText::Build( Atlas* atlas )
+{
+	if( !font->FillText( text, params ) )
+		return false;
+
+	QuadBatch* quadBatch = font->GetQuadBatch();
+
+	// The copy is made exactly as big as it needs to be, and the quads of each page are drawn as one range.
+	QuadBatch::VertexArray newVertexArray;
+	newVertexArray.reserve( quadBatch->GetVertexCount() );
+	rangeArray.clear();
+
+	for( unsigned int page = 0; page < quadBatch->GetPageLimit(); page++ )
+	{
+		const QuadBatch::VertexArray& pageVertexArray = quadBatch->GetPageVertexArray( page );
+		if( pageVertexArray.size() == 0 )
+			continue;
+
+		QuadBatch::Range range;
+		range.page = int( page );
+		range.first = GLint( newVertexArray.size() );
+		range.count = GLsizei( pageVertexArray.size() );
+		rangeArray.push_back( range );
+
+		newVertexArray.insert( newVertexArray.end(), pageVertexArray.begin(), pageVertexArray.end() );
+	}
+
+	quadBatch->Clear();
+
+	vertexArray.swap( newVertexArray );
+	atlasSerial = atlas->GetSerial();
+	buildCount++;
+
+	// Without buffer objects, we draw straight out of the copy.
+	GLFunctions::Load();
+	if( !GLFunctions::HasBufferObjects() || vertexArray.size() == 0 )
+		return true;
+
+	if( vertexBuffer == 0 )
+	{
+		GLFunctions::GenBuffers( 1, &vertexBuffer );
+		if( vertexBuffer == 0 )
+			return true;
+	}
+
+	GLFunctions::BindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+	GLFunctions::BufferData( GL_ARRAY_BUFFER, ptrdiff_t( vertexArray.size() * sizeof( QuadBatch::Vertex ) ), &vertexArray[0], GL_STATIC_DRAW );
+	GLFunctions::BindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	return true;
+}
+
+// RetainedText.cpp
@@ -0,0 +1,53 @@
+// RetainedText.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include "QuadBatch.h"
+
+// An instance of this class is text laid out once, under the font and settings of the system when it was made, with
+// its quads kept in a vertex buffer of its own.  Drawing it lays out nothing, and takes a call per atlas page.  The quads
+// are built again, on their own, if the atlas they were built against isn't the one the font would draw them from now,
+// as when the text is drawn at a new scale, and so from another strike.  Instances are made by the system's CreateText
+// and must be given back to its DestroyText, with the GL context current, before the system is finalized.
+class FontSys::RetainedText
+{
+public:
+
+	RetainedText( System* fontSystem, Font* font, const System::LayoutParams& params, const std::string& text );
+	virtual ~RetainedText( void );
+
+	// This is drawn just as the system's DrawText would draw the text, and is batched with the rest while batching.
+	bool Draw( void );
+	bool Draw( GLfloat x, GLfloat y );
+
+	// Build the quads now, for the atlas the current matrices would have them drawn from, rather than on the first draw.
+	bool Build( void );
+
+	const std::string& GetText( void ) { return text; }
+
+	// This is the memory the quads take up: those in the buffer object and the copy we keep for batching, each
+	// sixty-four bytes a glyph.  Without buffer objects, there's only the copy.
+	size_t GetByteCount( void );
+
+	// This is how many times the quads have been built, the first time included.
+	unsigned int GetBuildCount( void ) { return buildCount; }
+
+private:
+
+	bool Build( Atlas* atlas );
+
+	System* fontSystem;
+	Font* font;
+	System::LayoutParams params;
+	std::string text;
+
+	QuadBatch::VertexArray vertexArray;
+	QuadBatch::RangeArray rangeArray;
+	unsigned int atlasSerial;
+
+	GLuint vertexBuffer;
+	unsigned int buildCount;
+};
+
+// RetainedText.h
@@ -0,0 +1,80 @@
+// SharedMappedFile.cpp
+
+#include "SharedMappedFile.h"
+
+using namespace FontSys;
+
+SharedMappedFile::SharedMappedFile( void )
+{
+	refCount = 0;
+}
+
+/*virtual*/ SharedMappedFile::~SharedMappedFile( void )
+{
+	mappedFile.Close();
+}
+
+/*static*/ SharedMappedFile::SharedMappedFileMap& SharedMappedFile::GetSharedMappedFileMap( void )
+{
+	static SharedMappedFileMap sharedMappedFileMap;
+	return sharedMappedFileMap;
+}
+
+#if defined FONTSYS_THREADS
+
+/*static*/ std::mutex& SharedMappedFile::GetMutex( void )
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+#endif //FONTSYS_THREADS
+
+/*static*/ SharedMappedFile* SharedMappedFile::Acquire( const std::string& path )
+{
+#if defined FONTSYS_THREADS
+	std::lock_guard< std::mutex > lock( GetMutex() );
+#endif
+
+	SharedMappedFileMap& sharedMappedFileMap = GetSharedMappedFileMap();
+
+	SharedMappedFile* sharedFile = nullptr;
+
+	SharedMappedFileMap::iterator iter = sharedMappedFileMap.find( path );
+	if( iter != sharedMappedFileMap.end() )
+		sharedFile = iter->second;
+	else
+	{
+		sharedFile = new SharedMappedFile();
+		sharedFile->path = path;
+
+		if( !sharedFile->mappedFile.Open( path ) )
+		{
+			delete sharedFile;
+			return nullptr;
+		}
+
+		sharedMappedFileMap[ path ] = sharedFile;
+	}
+
+	sharedFile->refCount++;
+	return sharedFile;
+}
+
+/*static*/ void SharedMappedFile::Release( SharedMappedFile* sharedFile )
+{
+	if( !sharedFile )
+		return;
+
+#if defined FONTSYS_THREADS
+	std::lock_guard< std::mutex > lock( GetMutex() );
+#endif
+
+	if( --sharedFile->refCount > 0 )
+		return;
+
+	GetSharedMappedFileMap().erase( sharedFile->path );
+	delete sharedFile;
+}
+
+// SharedMappedFile.cpp
@@ -0,0 +1,40 @@
+// SharedMappedFile.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include "MappedFile.h"
+
+// An instance of this class is a read-only file mapping shared by everything in the process that opens the
+// same path, be it several fonts, several systems or several threads.  The file is mapped on the first acquire
+// and unmapped on the last release.  The bytes never change, so any thread may read them.
+class FontSys::SharedMappedFile
+{
+public:
+
+	// This returns null if the file can't be mapped.  Every successful acquire must be matched by a release.
+	static SharedMappedFile* Acquire( const std::string& path );
+	static void Release( SharedMappedFile* sharedFile );
+
+	const GLubyte* GetData( void ) { return mappedFile.GetData(); }
+	size_t GetSize( void ) { return mappedFile.GetSize(); }
+
+private:
+
+	SharedMappedFile( void );
+	virtual ~SharedMappedFile( void );
+
+	typedef std::map< std::string, SharedMappedFile* > SharedMappedFileMap;
+
+	static SharedMappedFileMap& GetSharedMappedFileMap( void );
+
+	MappedFile mappedFile;
+	std::string path;
+	unsigned int refCount;
+
+#if defined FONTSYS_THREADS
+	static std::mutex& GetMutex( void );
+#endif
+};
+
+// SharedMappedFile.h
@@ -0,0 +1,207 @@
+// TextBatch.cpp
+
+#include "TextBatch.h"
+#include "QuadBatch.h"
+#include "Atlas.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace FontSys;
+
+TextBatch::TextBatch( void )
+{
+}
+
+/*virtual*/ TextBatch::~TextBatch( void )
+{
+}
+
+void TextBatch::Clear( void )
+{
+	// Note that clearing a vector keeps its capacity.
+	for( unsigned int i = 0; i < groupArray.size(); i++ )
+		groupArray[i].vertexArray.clear();
+
+	orderMap.clear();
+}
+
+bool TextBatch::IsEmpty( void )
+{
+	for( unsigned int i = 0; i < groupArray.size(); i++ )
+		if( groupArray[i].vertexArray.size() > 0 )
+			return false;
+
+	return true;
+}
+
+// Fonts and atlases are ordered by when they were first added to the batch, so that drawing is the same from run to run.
+unsigned int TextBatch::GetOrder( void* key )
+{
+	OrderMap::iterator iter = orderMap.find( key );
+	if( iter != orderMap.end() )
+		return iter->second;
+
+	unsigned int order = unsigned( orderMap.size() );
+	orderMap[ key ] = order;
+	return order;
+}
+
+void TextBatch::AddQuads( Font* font, Atlas* atlas, bool distanceField, QuadBatch& quadBatch, const GLfloat* matrix, const GLfloat* color )
+{
+	for( unsigned int page = 0; page < quadBatch.GetPageLimit(); page++ )
+	{
+		const QuadBatch::VertexArray& quadVertexArray = quadBatch.GetPageVertexArray( page );
+		if( quadVertexArray.size() > 0 )
+			AddPageQuads( font, atlas, distanceField, int( page ), &quadVertexArray[0], unsigned( quadVertexArray.size() ), matrix, color );
+	}
+}
+
+void TextBatch::AddPageQuads( Font* font, Atlas* atlas, bool distanceField, int page, const QuadBatch::Vertex* quadVertexArray, unsigned int vertexCount,
+								const GLfloat* matrix, const GLfloat* color )
+{
+	// Distance fields are alpha-tested, which ignores the color's alpha.
+	GLubyte vertexColor[4];
+	for( int i = 0; i < 4; i++ )
+		vertexColor[i] = GLubyte( std::min( std::max( color[i], 0.f ), 1.f ) * 255.f + 0.5f );
+
+	if( distanceField )
+		vertexColor[3] = 255;
+
+	// Atlases are keyed by serial, since a freed one's address can be reused.
+	std::pair< unsigned int, int > groupKey( atlas->GetSerial(), page );
+
+	GroupMap::iterator iter = groupMap.find( groupKey );
+	if( iter == groupMap.end() )
+	{
+		groupArray.push_back( Group() );
+		iter = groupMap.insert( GroupMap::value_type( groupKey, unsigned( groupArray.size() - 1 ) ) ).first;
+	}
+
+	Group& group = groupArray[ iter->second ];
+
+	// Orders are only good for the batch they were given out in, so an empty group is set up again.
+	if( group.vertexArray.size() == 0 )
+	{
+		group.font = font;
+		group.atlas = atlas;
+		group.page = page;
+		group.distanceField = distanceField;
+		group.fontOrder = GetOrder( font );
+		group.atlasOrder = GetOrder( atlas );
+	}
+
+	for( unsigned int i = 0; i < vertexCount; i++ )
+	{
+		const QuadBatch::Vertex& quadVertex = quadVertexArray[i];
+
+		Vertex vertex;
+		vertex.x = matrix[0] * quadVertex.x + matrix[4] * quadVertex.y + matrix[12];
+		vertex.y = matrix[1] * quadVertex.x + matrix[5] * quadVertex.y + matrix[13];
+		vertex.z = matrix[2] * quadVertex.x + matrix[6] * quadVertex.y + matrix[14];
+		vertex.s = quadVertex.s;
+		vertex.t = quadVertex.t;
+		memcpy( vertex.color, vertexColor, sizeof( vertexColor ) );
+
+		group.vertexArray.push_back( vertex );
+	}
+}
+
+void TextBatch::DropEmptyGroups( void )
+{
+	unsigned int groupCount = 0;
+
+	for( unsigned int i = 0; i < groupArray.size(); i++ )
+	{
+		if( groupArray[i].vertexArray.size() == 0 )
+			continue;
+
+		if( groupCount != i )
+			std::swap( groupArray[ groupCount ], groupArray[i] );
+
+		groupCount++;
+	}
+
+	if( groupCount == groupArray.size() )
+		return;
+
+	groupArray.resize( groupCount );
+
+	groupMap.clear();
+	for( unsigned int i = 0; i < groupArray.size(); i++ )
+		groupMap[ std::make_pair( groupArray[i].atlas->GetSerial(), groupArray[i].page ) ] = i;
+}
+
+unsigned int TextBatch::Draw( void )
+{
+	// Whatever this batch didn't use goes, so that groups of atlases since freed don't linger.
+	DropEmptyGroups();
+
+	drawOrderArray.clear();
+
+	for( unsigned int i = 0; i < groupArray.size(); i++ )
+		if( groupArray[i].vertexArray.size() > 0 && groupArray[i].page < groupArray[i].atlas->GetPageCount() )
+			drawOrderArray.push_back(i);
+
+	const GroupArray& groups = groupArray;
+	std::sort( drawOrderArray.begin(), drawOrderArray.end(), [&groups]( unsigned int a, unsigned int b )
+	{
+		const Group& groupA = groups[a];
+		const Group& groupB = groups[b];
+
+		if( groupA.fontOrder != groupB.fontOrder )
+			return groupA.fontOrder < groupB.fontOrder;
+
+		if( groupA.atlasOrder != groupB.atlasOrder )
+			return groupA.atlasOrder < groupB.atlasOrder;
+
+		return groupA.page < groupB.page;
+	} );
+
+	glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glEnableClientState( GL_COLOR_ARRAY );
+
+	// The render mode only changes between fonts, if then.
+	int distanceField = -1;
+
+	for( unsigned int i = 0; i < drawOrderArray.size(); i++ )
+	{
+		Group& group = groupArray[ drawOrderArray[i] ];
+
+		if( int( group.distanceField ) != distanceField )
+		{
+			distanceField = int( group.distanceField );
+
+			if( group.distanceField )
+			{
+				glDisable( GL_BLEND );
+				glEnable( GL_ALPHA_TEST );
+				glAlphaFunc( GL_GEQUAL, 0.5f );
+			}
+			else
+			{
+				glDisable( GL_ALPHA_TEST );
+				glEnable( GL_BLEND );
+				glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+			}
+		}
+
+		glBindTexture( GL_TEXTURE_2D, group.atlas->GetPageTexture( group.page ) );
+
+		glVertexPointer( 3, GL_FLOAT, sizeof( Vertex ), &group.vertexArray[0].x );
+		glTexCoordPointer( 2, GL_FLOAT, sizeof( Vertex ), &group.vertexArray[0].s );
+		glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof( Vertex ), group.vertexArray[0].color );
+
+		glDrawArrays( GL_QUADS, 0, GLsizei( group.vertexArray.size() ) );
+
+		group.font->AddDrawCalls(1);
+	}
+
+	glPopClientAttrib();
+
+	return unsigned( drawOrderArray.size() );
+}
+
+// TextBatch.cpp
@@ -0,0 +1,66 @@
+// TextBatch.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include "QuadBatch.h"
+
+// An instance of this class collects the glyph quads of many draws over a frame so that they can all be drawn
+// at once.  Quads are taken to eye space, and given their color, as they're added, so that draws with different
+// transforms and colors can share a draw call.  They are grouped by atlas page, and the groups are drawn in order
+// of font, then atlas, then page, one draw call each.  Arrays are kept from frame to frame, so a steady frame doesn't allocate.
+class FontSys::TextBatch
+{
+public:
+
+	TextBatch( void );
+	virtual ~TextBatch( void );
+
+	struct Vertex
+	{
+		GLfloat x, y, z;
+		GLfloat s, t;
+		GLubyte color[4];
+	};
+
+	void Clear( void );
+	bool IsEmpty( void );
+
+	// The quads are taken through the given column-major modelview matrix, which is assumed to be affine.
+	void AddQuads( Font* font, Atlas* atlas, bool distanceField, QuadBatch& quadBatch, const GLfloat* matrix, const GLfloat* color );
+	void AddPageQuads( Font* font, Atlas* atlas, bool distanceField, int page, const QuadBatch::Vertex* quadVertexArray, unsigned int vertexCount,
+						const GLfloat* matrix, const GLfloat* color );
+
+	// The modelview matrix should be the identity, and the projection what it was when the quads were added.
+	// Only the array state is left as we found it.  This returns the number of draw calls made.
+	unsigned int Draw( void );
+
+private:
+
+	struct Group
+	{
+		Font* font;
+		Atlas* atlas;
+		int page;
+		bool distanceField;
+		unsigned int fontOrder;
+		unsigned int atlasOrder;
+		std::vector< Vertex > vertexArray;
+	};
+
+	typedef std::vector< Group > GroupArray;
+	typedef std::map< std::pair< unsigned int, int >, unsigned int > GroupMap;		// This is keyed by atlas serial and page.
+	typedef std::map< void*, unsigned int > OrderMap;
+
+	unsigned int GetOrder( void* key );
+	void DropEmptyGroups( void );
+
+	// Groups outlive the batch, so that their arrays are reused, but not a batch that leaves them empty.  That way
+	// the groups of freed atlases don't pile up.
+	GroupArray groupArray;
+	GroupMap groupMap;
+	OrderMap orderMap;
+	std::vector< unsigned int > drawOrderArray;
+};
+
+// TextBatch.h
@@ -0,0 +1,434 @@
+// TextBuffer.cpp
+
+#include "TextBuffer.h"
+#include "TextBatch.h"
+#include "Atlas.h"
+#include "GLFunctions.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace FontSys;
+
+TextBuffer::TextBuffer( System* fontSystem )
+{
+	this->fontSystem = fontSystem;
+	editPending = false;
+	editBegin = 0;
+	editOldEnd = 0;
+	editNewEnd = 0;
+	layoutFont = nullptr;
+	layoutAtlasSerial = 0;
+	memset( &layoutParams, 0, sizeof( System::LayoutParams ) );
+	rangesValid = false;
+	vertexBuffer = 0;
+	vertexBufferCapacity = 0;
+	dirtyFirst = 0;
+	dirtyEnd = 0;
+	lastLayoutLineCount = 0;
+	lastUploadByteCount = 0;
+}
+
+/*virtual*/ TextBuffer::~TextBuffer( void )
+{
+	if( vertexBuffer != 0 && GLFunctions::HasBufferObjects() )
+		GLFunctions::DeleteBuffers( 1, &vertexBuffer );
+}
+
+void TextBuffer::SetText( const std::string& text )
+{
+	NoteEdit( 0, this->text.length(), text.length() );
+	this->text = text;
+}
+
+void TextBuffer::Append( const std::string& text )
+{
+	Insert( this->text.length(), text );
+}
+
+void TextBuffer::Insert( size_t offset, const std::string& text )
+{
+	if( text.empty() )
+		return;
+
+	offset = std::min( offset, this->text.length() );
+
+	NoteEdit( offset, 0, text.length() );
+	this->text.insert( offset, text );
+}
+
+void TextBuffer::Delete( size_t offset, size_t length )
+{
+	offset = std::min( offset, text.length() );
+	length = std::min( length, text.length() - offset );
+
+	if( length == 0 )
+		return;
+
+	NoteEdit( offset, length, 0 );
+	text.erase( offset, length );
+}
+
+void TextBuffer::Clear( void )
+{
+	SetText( std::string() );
+}
+
+void TextBuffer::NoteEdit( size_t offset, size_t removedLength, size_t insertedLength )
+{
+	if( !editPending )
+	{
+		editPending = true;
+		editBegin = offset;
+		editOldEnd = offset + removedLength;
+		editNewEnd = offset + insertedLength;
+		return;
+	}
+
+	// The edited span grows to take in this edit too.  Text it takes in past the new end comes from past the old end.
+	editBegin = std::min( editBegin, offset );
+
+	if( offset + removedLength > editNewEnd )
+	{
+		editOldEnd += offset + removedLength - editNewEnd;
+		editNewEnd = offset + removedLength;
+	}
+
+	editNewEnd = editNewEnd + insertedLength - removedLength;
+}
+
+bool TextBuffer::Draw( GLfloat x, GLfloat y )
+{
+	glPushMatrix();
+	glTranslatef( x, y, 0.f );
+
+	bool success = Draw();
+
+	glPopMatrix();
+
+	return success;
+}
+
+bool TextBuffer::Draw( void )
+{
+	Font* font = fontSystem->GetCurrentFont();
+	if( !font )
+		return false;
+
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
+
+	Atlas* atlas = font->GetStrikeAtlas( params.lineHeight );
+	if( !atlas )
+		return false;
+
+	// A new font or new settings leave nothing of the old layout worth keeping.  Neither does a different atlas, as when
+	// the text is drawn at a new scale, from another strike, since the vertices hold its texture coordinates.
+	if( font != layoutFont || atlas->GetSerial() != layoutAtlasSerial || !System::LayoutParamsMatch( params, layoutParams ) )
+	{
+		lineArray.clear();
+		vertexArray.clear();
+		drawVertexArray.clear();
+		layoutFont = font;
+		layoutAtlasSerial = atlas->GetSerial();
+		layoutParams = params;
+
+		editPending = true;
+		editBegin = 0;
+		editOldEnd = 0;
+		editNewEnd = text.length();
+	}
+
+	lastLayoutLineCount = 0;
+	lastUploadByteCount = 0;
+
+	if( editPending )
+		LayoutLines( font, params );
+
+	if( vertexArray.size() == 0 )
+		return true;
+
+	if( !rangesValid )
+		MakeRanges();
+
+	// While batching, the vertices go into the batch like anyone else's, and the buffer object is left alone.
+	TextBatch* textBatch = fontSystem->GetTextBatch();
+	if( textBatch )
+	{
+		GLfloat matrix[16];
+		glGetFloatv( GL_MODELVIEW_MATRIX, matrix );
+
+		GLfloat color[4];
+		glGetFloatv( GL_CURRENT_COLOR, color );
+
+		for( unsigned int i = 0; i < rangeArray.size(); i++ )
+		{
+			const QuadBatch::Range& range = rangeArray[i];
+			textBatch->AddPageQuads( font, atlas, font->IsDistanceField(), range.page, &drawVertexArray[ range.first ], unsigned( range.count ), matrix, color );
+		}
+
+		return true;
+	}
+
+	GLFunctions::Load();
+	Upload();
+
+	// Without buffer objects, we draw straight out of our own copy.
+	font->BeginDraw();
+	font->AddDrawCalls( QuadBatch::DrawRanges( atlas, vertexBuffer, drawVertexArray, rangeArray ) );
+	font->EndDraw();
+
+	return true;
+}
+
+void TextBuffer::LayoutLines( Font* font, const System::LayoutParams& params )
+{
+	size_t lineCount = lineArray.size();
+
+	// Lines before the one the edit starts in are kept, except the one just before it, whose last word might now fit
+	// on it, or no longer.  Any line further back broke on a word that's still where it was.
+	size_t first = 0;
+	if( lineCount > 0 )
+	{
+		size_t low = 0, high = lineCount;
+		while( high - low > 1 )
+		{
+			size_t middle = ( low + high ) / 2;
+			if( lineArray[ middle ].begin <= editBegin )
+				low = middle;
+			else
+				high = middle;
+		}
+
+		first = low > 0 ? low - 1 : 0;
+	}
+
+	size_t begin = first < lineCount ? lineArray[ first ].begin : 0;
+	ptrdiff_t delta = ptrdiff_t( editNewEnd ) - ptrdiff_t( editOldEnd );
+
+	newLineArray.clear();
+	newVertexArray.clear();
+
+	QuadBatch* quadBatch = font->GetQuadBatch();
+	quadBatch->Clear();
+
+	// Base lines are summed line by line, just as DrawText sums them, for the same rounding.
+	GLfloat baseLine = first > 0 ? lineArray[ first - 1 ].baseLine + params.baseLineDelta : 0.f;
+
+	// Once we're past the edit, a line that starts where an old one now does, and in the same way, is laid out
+	// just as it was, and so is everything after it.  The old lines from the first up to that one are replaced.
+	size_t last = first;
+	bool stable = false;
+
+	while( begin < text.length() )
+	{
+		bool paragraphStart = ( begin == 0 || text[ begin - 1 ] == '\n' );
+
+		if( begin >= editNewEnd )
+		{
+			while( last < lineCount && ( lineArray[ last ].begin < editOldEnd || ptrdiff_t( lineArray[ last ].begin ) + delta < ptrdiff_t( begin ) ) )
+				last++;
+
+			if( last < lineCount && ptrdiff_t( lineArray[ last ].begin ) + delta == ptrdiff_t( begin ) && lineArray[ last ].paragraphStart == paragraphStart )
+			{
+				stable = true;
+				break;
+			}
+		}
+
+		size_t next = 0;
+		if( !font->FillBufferLine( text, begin, params, 0.f, next ) )
+			break;
+
+		Line line;
+		line.begin = begin;
+		line.paragraphStart = paragraphStart;
+		line.baseLine = baseLine;
+		line.firstVertex = unsigned( newVertexArray.size() );
+		line.vertexCount = 0;
+
+		for( unsigned int page = 0; page < quadBatch->GetPageLimit(); page++ )
+		{
+			const QuadBatch::VertexArray& pageVertexArray = quadBatch->GetPageVertexArray( page );
+			if( pageVertexArray.size() == 0 )
+				continue;
+
+			Run run;
+			run.page = int( page );
+			run.first = line.vertexCount;
+			run.count = unsigned( pageVertexArray.size() );
+			line.runArray.push_back( run );
+
+			newVertexArray.insert( newVertexArray.end(), pageVertexArray.begin(), pageVertexArray.end() );
+			line.vertexCount += run.count;
+		}
+
+		quadBatch->Clear();
+
+		newLineArray.push_back( line );
+
+		baseLine += params.baseLineDelta;
+		begin = next;
+	}
+
+	if( !stable )
+		last = lineCount;
+
+	// The new lines and their vertices go in place of the old.
+	size_t oldFirstVertex = first < lineCount ? lineArray[ first ].firstVertex : vertexArray.size();
+	size_t oldEndVertex = last < lineCount ? lineArray[ last ].firstVertex : vertexArray.size();
+
+	vertexArray.erase( vertexArray.begin() + oldFirstVertex, vertexArray.begin() + oldEndVertex );
+	vertexArray.insert( vertexArray.begin() + oldFirstVertex, newVertexArray.begin(), newVertexArray.end() );
+
+	ptrdiff_t vertexShift = ptrdiff_t( newVertexArray.size() ) - ptrdiff_t( oldEndVertex - oldFirstVertex );
+	ptrdiff_t lineShift = ptrdiff_t( newLineArray.size() ) - ptrdiff_t( last - first );
+
+	for( size_t i = last; i < lineCount; i++ )
+	{
+		lineArray[i].begin = size_t( ptrdiff_t( lineArray[i].begin ) + delta );
+		lineArray[i].firstVertex = unsigned( ptrdiff_t( lineArray[i].firstVertex ) + vertexShift );
+	}
+
+	for( unsigned int i = 0; i < newLineArray.size(); i++ )
+		newLineArray[i].firstVertex += unsigned( oldFirstVertex );
+
+	lineArray.erase( lineArray.begin() + first, lineArray.begin() + last );
+	lineArray.insert( lineArray.begin() + first, newLineArray.begin(), newLineArray.end() );
+
+	// The lines after ours move up or down with the number of lines.
+	if( lineShift != 0 )
+	{
+		for( size_t i = first + newLineArray.size(); i < lineArray.size(); i++ )
+		{
+			lineArray[i].baseLine = baseLine;
+			baseLine += params.baseLineDelta;
+		}
+	}
+
+	// Only the vertices that moved or changed need uploading.
+	size_t tailVertex = oldFirstVertex + newVertexArray.size();
+	size_t changedEnd = ( vertexShift != 0 || lineShift != 0 ) ? vertexArray.size() : tailVertex;
+
+	drawVertexArray.resize( vertexArray.size() );
+	PlaceLines( oldFirstVertex, changedEnd );
+
+	if( oldFirstVertex < changedEnd )
+	{
+		if( dirtyFirst < dirtyEnd )
+		{
+			dirtyFirst = std::min( dirtyFirst, oldFirstVertex );
+			dirtyEnd = std::max( dirtyEnd, changedEnd );
+		}
+		else
+		{
+			dirtyFirst = oldFirstVertex;
+			dirtyEnd = changedEnd;
+		}
+	}
+
+	editPending = false;
+	rangesValid = false;
+	lastLayoutLineCount = unsigned( newLineArray.size() );
+}
+
+void TextBuffer::PlaceLines( size_t firstVertex, size_t endVertex )
+{
+	if( firstVertex >= endVertex )
+		return;
+
+	// Find the line the first vertex is in, and go from there.
+	size_t low = 0, high = lineArray.size();
+	while( high - low > 1 )
+	{
+		size_t middle = ( low + high ) / 2;
+		if( lineArray[ middle ].firstVertex <= firstVertex )
+			low = middle;
+		else
+			high = middle;
+	}
+
+	for( size_t i = low; i < lineArray.size() && lineArray[i].firstVertex < endVertex; i++ )
+	{
+		const Line& line = lineArray[i];
+
+		size_t j = std::max( firstVertex, size_t( line.firstVertex ) );
+		size_t end = std::min( endVertex, size_t( line.firstVertex + line.vertexCount ) );
+
+		for( ; j < end; j++ )
+		{
+			drawVertexArray[j] = vertexArray[j];
+			drawVertexArray[j].y = line.baseLine + vertexArray[j].y;
+		}
+	}
+}
+
+void TextBuffer::MakeRanges( void )
+{
+	rangeArray.clear();
+
+	for( unsigned int i = 0; i < lineArray.size(); i++ )
+	{
+		const Line& line = lineArray[i];
+
+		for( unsigned int j = 0; j < line.runArray.size(); j++ )
+		{
+			const Run& run = line.runArray[j];
+
+			QuadBatch::Range range;
+			range.page = run.page;
+			range.first = GLint( line.firstVertex + run.first );
+			range.count = GLsizei( run.count );
+
+			if( rangeArray.size() > 0 && rangeArray.back().page == range.page && rangeArray.back().first + rangeArray.back().count == range.first )
+				rangeArray.back().count += range.count;
+			else
+				rangeArray.push_back( range );
+		}
+	}
+
+	// Each page is bound once.
+	std::stable_sort( rangeArray.begin(), rangeArray.end(), []( const QuadBatch::Range& rangeA, const QuadBatch::Range& rangeB ) { return rangeA.page < rangeB.page; } );
+
+	rangesValid = true;
+}
+
+void TextBuffer::Upload( void )
+{
+	dirtyEnd = std::min( dirtyEnd, vertexArray.size() );
+
+	if( !GLFunctions::HasBufferObjects() || vertexArray.size() == 0 )
+		return;
+
+	if( vertexBuffer == 0 )
+	{
+		GLFunctions::GenBuffers( 1, &vertexBuffer );
+		if( vertexBuffer == 0 )
+			return;
+	}
+
+	GLFunctions::BindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+
+	// The buffer grows in big steps, and everything goes up again when it does.
+	const size_t vertexSize = sizeof( QuadBatch::Vertex );
+	if( vertexArray.size() > vertexBufferCapacity )
+	{
+		vertexBufferCapacity = std::max( vertexArray.size() * 2, size_t( 1024 ) );
+		GLFunctions::BufferData( GL_ARRAY_BUFFER, ptrdiff_t( vertexBufferCapacity * vertexSize ), nullptr, GL_DYNAMIC_DRAW );
+
+		dirtyFirst = 0;
+		dirtyEnd = vertexArray.size();
+	}
+
+	if( dirtyFirst < dirtyEnd )
+	{
+		GLFunctions::BufferSubData( GL_ARRAY_BUFFER, ptrdiff_t( dirtyFirst * vertexSize ), ptrdiff_t( ( dirtyEnd - dirtyFirst ) * vertexSize ), &drawVertexArray[ dirtyFirst ] );
+		lastUploadByteCount = ( dirtyEnd - dirtyFirst ) * vertexSize;
+	}
+
+	GLFunctions::BindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	dirtyFirst = 0;
+	dirtyEnd = 0;
+}
+
+// TextBuffer.cpp
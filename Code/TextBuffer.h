@@ -0,0 +1,105 @@
+// TextBuffer.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include "QuadBatch.h"
+
+// An instance of this class retains text that changes a little at a time, like that of a log or a chat pane,
+// along with its layout and the vertex data to draw it.  An edit only has the lines from the one before it up to
+// the next line that starts where it did before laid out again, and only the vertices that changed are uploaded.
+// Lines end where the text wraps and at newlines.  The layout follows the system's current font and settings;
+// changing them lays everything out again.  Offsets and lengths are in bytes of UTF-8, and should fall between
+// characters.  The buffer must be destroyed while the GL context is still current, and before the system is finalized.
+class FontSys::TextBuffer
+{
+public:
+
+	TextBuffer( System* fontSystem );
+	virtual ~TextBuffer( void );
+
+	void SetText( const std::string& text );
+	void Append( const std::string& text );
+	void Insert( size_t offset, const std::string& text );
+	void Delete( size_t offset, size_t length );
+	void Clear( void );
+
+	const std::string& GetText( void ) { return text; }
+
+	// The text is drawn just as the system's DrawText would draw it, and is batched with the rest while batching.
+	// Layout and uploads are put off until then.
+	bool Draw( void );
+	bool Draw( GLfloat x, GLfloat y );
+
+	// These tell how things went on the last draw.
+	unsigned int GetLineCount( void ) { return unsigned( lineArray.size() ); }
+	unsigned int GetLastLayoutLineCount( void ) { return lastLayoutLineCount; }
+	size_t GetLastUploadByteCount( void ) { return lastUploadByteCount; }
+
+private:
+
+	// The quads of a line are grouped by page, each run of them drawn from the same page.
+	struct Run
+	{
+		int page;
+		unsigned int first;			// This is counted in vertices from the line's first vertex.
+		unsigned int count;
+	};
+
+	typedef std::vector< Run > RunArray;
+
+	struct Line
+	{
+		size_t begin;
+		bool paragraphStart;		// This is true of the first line and those after newlines, which start flush with the origin.
+		GLfloat baseLine;
+		unsigned int firstVertex;
+		unsigned int vertexCount;
+		RunArray runArray;
+	};
+
+	typedef std::vector< Line > LineArray;
+
+	void NoteEdit( size_t offset, size_t removedLength, size_t insertedLength );
+	void LayoutLines( Font* font, const System::LayoutParams& params );
+	void PlaceLines( size_t firstVertex, size_t endVertex );
+	void MakeRanges( void );
+	void Upload( void );
+
+	System* fontSystem;
+	std::string text;
+	LineArray lineArray;
+
+	// Lines are laid out on a base line of zero, and kept that way, so that one that only moves needn't be laid out
+	// again.  The vertices drawn have the line's base line added, the same way the system's DrawText adds it.
+	QuadBatch::VertexArray vertexArray;
+	QuadBatch::VertexArray drawVertexArray;
+
+	// Every edit since the last layout lies between the beginning and the new end.  The text before the beginning,
+	// and after the new end, is what it was before them, with what was after the old end now after the new end.
+	bool editPending;
+	size_t editBegin;
+	size_t editOldEnd;
+	size_t editNewEnd;
+
+	// The layout is only good for the font, atlas and settings it was made with.
+	Font* layoutFont;
+	unsigned int layoutAtlasSerial;
+	System::LayoutParams layoutParams;
+
+	LineArray newLineArray;
+	QuadBatch::VertexArray newVertexArray;
+	QuadBatch::RangeArray rangeArray;			// Consecutive runs of the same page are drawn with one call.
+	bool rangesValid;
+
+	// Vertices from the first dirty one up to, but not including, the dirty end are yet to be uploaded.
+	GLuint vertexBuffer;
+	size_t vertexBufferCapacity;
+	size_t dirtyFirst;
+	size_t dirtyEnd;
+
+	unsigned int lastLayoutLineCount;
+	size_t lastUploadByteCount;
+};
+
+// TextBuffer.h
@@ -0,0 +1,186 @@
+// TextDocument.cpp
+
+#include "TextDocument.h"
+#include "TextBatch.h"
+#include "QuadBatch.h"
+#include "Atlas.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace FontSys;
+
+TextDocument::TextDocument( System* fontSystem )
+{
+	this->fontSystem = fontSystem;
+	indexValid = false;
+	indexedLength = 0;
+	indexFont = nullptr;
+	memset( &indexParams, 0, sizeof( System::LayoutParams ) );
+	lastDrawLineCount = 0;
+}
+
+/*virtual*/ TextDocument::~TextDocument( void )
+{
+}
+
+void TextDocument::SetText( const std::string& text )
+{
+	this->text = text;
+	indexValid = false;
+}
+
+void TextDocument::Append( const std::string& text )
+{
+	this->text += text;
+}
+
+void TextDocument::Clear( void )
+{
+	SetText( std::string() );
+}
+
+bool TextDocument::UpdateIndex( void )
+{
+	Font* font = fontSystem->GetCurrentFont();
+	if( !font )
+		return false;
+
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
+
+	return UpdateIndex( font, params );
+}
+
+bool TextDocument::UpdateIndex( Font* font, const System::LayoutParams& params )
+{
+	if( font != indexFont || !System::LayoutParamsMatch( params, indexParams ) )
+	{
+		indexFont = font;
+		indexParams = params;
+		indexValid = false;
+	}
+
+	if( indexValid && indexedLength == text.length() )
+		return true;
+
+	// Appended text can only change the last line, and where the one before it breaks, since its last word might now
+	// fit on it.  Everything before that stays as it was.
+	size_t first = 0;
+	if( indexValid && lineArray.size() > 2 )
+		first = lineArray.size() - 2;
+
+	size_t begin = first < lineArray.size() ? lineArray[ first ].begin : 0;
+
+	// Base lines are summed line by line, just as DrawText sums them, for the same rounding.
+	GLfloat baseLine = first > 0 ? lineArray[ first - 1 ].baseLine + params.baseLineDelta : 0.f;
+
+	lineArray.resize( first );
+
+	while( begin < text.length() )
+	{
+		Line line;
+		line.begin = begin;
+		line.baseLine = baseLine;
+
+		size_t next = 0;
+		if( !font->MeasureBufferLine( text, begin, params, line.width, next ) )
+		{
+			indexValid = false;
+			return false;
+		}
+
+		lineArray.push_back( line );
+
+		baseLine += params.baseLineDelta;
+		begin = next;
+	}
+
+	indexValid = true;
+	indexedLength = text.length();
+
+	return true;
+}
+
+bool TextDocument::Draw( GLfloat minX, GLfloat minY, GLfloat maxX, GLfloat maxY )
+{
+	lastDrawLineCount = 0;
+
+	Font* font = fontSystem->GetCurrentFont();
+	if( !font )
+		return false;
+
+	System::LayoutParams params;
+	fontSystem->GetLayoutParams( params );
+
+	if( !UpdateIndex( font, params ) )
+		return false;
+
+	Atlas* atlas = font->GetStrikeAtlas( params.lineHeight );
+	if( !atlas )
+		return false;
+
+	// A glyph can reach a line height or so past its base line either way, or past either end of the line.
+	GLfloat margin = params.lineHeight;
+
+	// Lines are in order of base line, so the first one in view is found by bisection, and the rest follow it.
+	bool descending = ( params.baseLineDelta <= 0.f );
+	LineArray::const_iterator iter = std::partition_point( lineArray.begin(), lineArray.end(), [=]( const Line& line )
+	{
+		return( descending ? line.baseLine - margin > maxY : line.baseLine + margin < minY );
+	} );
+
+	QuadBatch* quadBatch = font->GetQuadBatch();
+	quadBatch->Clear();
+
+	for( ; iter != lineArray.end(); iter++ )
+	{
+		const Line& line = *iter;
+
+		if( descending ? line.baseLine + margin < minY : line.baseLine - margin > maxY )
+			break;
+
+		// Justified lines may be placed anywhere across the line width.
+		GLfloat lineEnd = line.width;
+		if( params.lineWidth > 0.f && params.justification != System::JUSTIFY_LEFT )
+			lineEnd = std::max( lineEnd, params.lineWidth );
+
+		if( lineEnd + margin < minX || -margin > maxX )
+			continue;
+
+		size_t next = 0;
+		if( !font->FillBufferLine( text, line.begin, params, line.baseLine, next ) )
+		{
+			quadBatch->Clear();
+			return false;
+		}
+
+		lastDrawLineCount++;
+	}
+
+	if( quadBatch->IsEmpty() )
+		return true;
+
+	TextBatch* textBatch = fontSystem->GetTextBatch();
+	if( textBatch )
+	{
+		GLfloat matrix[16];
+		glGetFloatv( GL_MODELVIEW_MATRIX, matrix );
+
+		GLfloat color[4];
+		glGetFloatv( GL_CURRENT_COLOR, color );
+
+		textBatch->AddQuads( font, atlas, font->IsDistanceField(), *quadBatch, matrix, color );
+	}
+	else
+	{
+		font->BeginDraw();
+		font->AddDrawCalls( quadBatch->Draw( atlas ) );
+		font->EndDraw();
+	}
+
+	quadBatch->Clear();
+
+	return true;
+}
+
+// TextDocument.cpp
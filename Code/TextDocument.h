@@ -0,0 +1,66 @@
+// TextDocument.h
+
+#pragma once
+
+#include "FontSystem.h"
+
+// An instance of this class holds a long text, like a log or a book, and an index of its lines: where each starts,
+// the base line it's drawn on and how wide it is.  The index is made with font metrics alone, once, and then only
+// added to as text is appended.  Drawing lays out and draws just the lines in view, so that the cost of a frame goes
+// with what's on screen rather than with the length of the text.  Lines come out just as the system's DrawText would
+// draw them.  The index follows the system's current font and settings; changing them makes it again.
+class FontSys::TextDocument
+{
+public:
+
+	TextDocument( System* fontSystem );
+	virtual ~TextDocument( void );
+
+	void SetText( const std::string& text );
+	void Append( const std::string& text );
+	void Clear( void );
+
+	const std::string& GetText( void ) { return text; }
+
+	struct Line
+	{
+		size_t begin;			// This is the byte of the text the line starts at.
+		GLfloat baseLine;
+		GLfloat width;			// This is the width MeasureText gives the line.
+	};
+
+	// The index is brought up to date before drawing, but this can be called to do it sooner.
+	bool UpdateIndex( void );
+
+	unsigned int GetLineCount( void ) { return unsigned( lineArray.size() ); }
+	const Line& GetLine( unsigned int index ) { return lineArray[ index ]; }
+
+	// The view is a rectangle in the space the text is drawn in, where the first line's base line lies at zero.
+	// Only lines that reach into it are drawn.  While batching, they're batched with the rest.
+	bool Draw( GLfloat minX, GLfloat minY, GLfloat maxX, GLfloat maxY );
+
+	// This is how many lines the last draw laid out and drew.
+	unsigned int GetLastDrawLineCount( void ) { return lastDrawLineCount; }
+
+private:
+
+	bool UpdateIndex( Font* font, const System::LayoutParams& params );
+
+	typedef std::vector< Line > LineArray;
+
+	System* fontSystem;
+	std::string text;
+	LineArray lineArray;
+
+	// Text appended since the index was last brought up to date starts at the indexed length.
+	bool indexValid;
+	size_t indexedLength;
+
+	// The index is only good for the font and settings it was made with.
+	Font* indexFont;
+	System::LayoutParams indexParams;
+
+	unsigned int lastDrawLineCount;
+};
+
+// TextDocument.h
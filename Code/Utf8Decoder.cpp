@@ -0,0 +1,134 @@
+// Utf8Decoder.cpp
+
+#include "Utf8Decoder.h"
+#if defined __SSE2__ || defined _M_X64 || ( defined _M_IX86_FP && _M_IX86_FP >= 2 )
+#	include <emmintrin.h>
+#	define FONTSYS_SSE2
+#endif
+#include <string.h>
+
+using namespace FontSys;
+
+static const FT_ULong REPLACEMENT_CHARACTER = 0xFFFD;
+
+Utf8Decoder::Utf8Decoder( const std::string& text )
+{
+	begin = ( const unsigned char* )text.data();
+	cursor = begin;
+	asciiEnd = begin;
+	end = begin + text.length();
+}
+
+Utf8Decoder::Utf8Decoder( const char* text, size_t length )
+{
+	begin = ( const unsigned char* )text;
+	cursor = begin;
+	asciiEnd = begin;
+	end = begin + length;
+}
+
+void Utf8Decoder::ScanAscii( void )
+{
+	const unsigned char* scan = cursor;
+
+#if defined FONTSYS_SSE2
+	while( end - scan >= 16 )
+	{
+		__m128i chunk = _mm_loadu_si128( ( const __m128i* )scan );
+		int mask = _mm_movemask_epi8( chunk );		// One bit per byte with its high bit set.
+		if( mask != 0 )
+		{
+			int i = 0;
+			while( ( mask & ( 1 << i ) ) == 0 )
+				i++;
+
+			asciiEnd = scan + i;
+			return;
+		}
+
+		scan += 16;
+	}
+#else
+	while( end - scan >= 8 )
+	{
+		unsigned long long chunk;
+		memcpy( &chunk, scan, sizeof( chunk ) );
+		if( chunk & 0x8080808080808080ull )
+			break;
+
+		scan += 8;
+	}
+#endif
+
+	while( scan < end && *scan < 0x80 )
+		scan++;
+
+	asciiEnd = scan;
+}
+
+bool Utf8Decoder::NextSlow( FT_ULong& charCode )
+{
+	if( cursor >= end )
+		return false;
+
+	if( *cursor < 0x80 )
+	{
+		ScanAscii();
+		charCode = *cursor++;
+		return true;
+	}
+
+	unsigned char lead = *cursor;
+	int length = 0;
+	FT_ULong minimum = 0;
+
+	if( ( lead & 0xE0 ) == 0xC0 )
+	{
+		length = 2;
+		minimum = 0x80;
+		charCode = lead & 0x1F;
+	}
+	else if( ( lead & 0xF0 ) == 0xE0 )
+	{
+		length = 3;
+		minimum = 0x800;
+		charCode = lead & 0x0F;
+	}
+	else if( ( lead & 0xF8 ) == 0xF0 )
+	{
+		length = 4;
+		minimum = 0x10000;
+		charCode = lead & 0x07;
+	}
+
+	// A bad sequence costs us one byte and one replacement character.
+	if( length == 0 || end - cursor < length )
+	{
+		cursor++;
+		charCode = REPLACEMENT_CHARACTER;
+		return true;
+	}
+
+	for( int i = 1; i < length; i++ )
+	{
+		unsigned char trail = cursor[i];
+		if( ( trail & 0xC0 ) != 0x80 )
+		{
+			cursor++;
+			charCode = REPLACEMENT_CHARACTER;
+			return true;
+		}
+
+		charCode = ( charCode << 6 ) | ( trail & 0x3F );
+	}
+
+	cursor += length;
+
+	// Reject overlong forms, surrogates and anything beyond the last plane.
+	if( charCode < minimum || ( charCode >= 0xD800 && charCode <= 0xDFFF ) || charCode > 0x10FFFF )
+		charCode = REPLACEMENT_CHARACTER;
+
+	return true;
+}
+
+// Utf8Decoder.cpp
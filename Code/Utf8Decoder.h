@@ -0,0 +1,43 @@
+// Utf8Decoder.h
+
+#pragma once
+
+#include "FontSystem.h"
+
+// An instance of this class walks a UTF-8 string one code-point at a time without copying it.
+// Runs of plain ASCII are found up to 16 bytes at a time (using SSE2 where available) and are
+// then handed out without any decoding work.  Malformed sequences decode as U+FFFD.
+class FontSys::Utf8Decoder
+{
+public:
+
+	Utf8Decoder( const std::string& text );
+	Utf8Decoder( const char* text, size_t length );
+
+	// Return false once the end of the text is reached.
+	bool Next( FT_ULong& charCode )
+	{
+		if( cursor < asciiEnd )
+		{
+			charCode = *cursor++;
+			return true;
+		}
+
+		return NextSlow( charCode );
+	}
+
+	// This is the number of bytes consumed so far.
+	size_t GetOffset( void ) { return size_t( cursor - begin ); }
+
+private:
+
+	bool NextSlow( FT_ULong& charCode );
+	void ScanAscii( void );
+
+	const unsigned char* begin;
+	const unsigned char* cursor;
+	const unsigned char* asciiEnd;		// Everything from the cursor up to here is known to be ASCII.
+	const unsigned char* end;
+};
+
+// Utf8Decoder.h
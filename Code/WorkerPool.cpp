@@ -0,0 +1,180 @@
+// WorkerPool.cpp
+
+#include "WorkerPool.h"
+
+using namespace FontSys;
+
+WorkerPool::WorkerPool( unsigned int threadCount /*= 0*/ )
+{
+#if defined FONTSYS_THREADS
+	if( threadCount == 0 )
+		threadCount = std::thread::hardware_concurrency();
+
+	if( threadCount == 0 )
+		threadCount = 1;
+
+	workerCount = threadCount;
+	job = nullptr;
+	rangeArray = new Range[ workerCount ];
+	for( unsigned int worker = 0; worker < workerCount; worker++ )
+		rangeArray[ worker ].bounds = 0;
+	generation = 0;
+	busyCount = 0;
+	quit = false;
+
+	// Worker zero is whoever calls us.
+	for( unsigned int worker = 1; worker < workerCount; worker++ )
+		threadArray.push_back( std::thread( &WorkerPool::ThreadMain, this, worker ) );
+#else
+	workerCount = 1;
+#endif
+}
+
+/*virtual*/ WorkerPool::~WorkerPool( void )
+{
+#if defined FONTSYS_THREADS
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		quit = true;
+	}
+
+	startCondition.notify_all();
+
+	for( unsigned int i = 0; i < threadArray.size(); i++ )
+		threadArray[i].join();
+
+	delete[] rangeArray;
+#endif
+}
+
+void WorkerPool::Run( unsigned int count, const Job& job )
+{
+#if defined FONTSYS_THREADS
+	// It isn't worth waking anyone for a single job.
+	if( threadArray.size() > 0 && count > 1 )
+	{
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+			this->job = &job;
+
+			// The indices are dealt out in even shares to begin with.
+			for( unsigned int worker = 0; worker < workerCount; worker++ )
+			{
+				unsigned int first = unsigned( uint64_t( count ) * worker / workerCount );
+				unsigned int end = unsigned( uint64_t( count ) * ( worker + 1 ) / workerCount );
+				rangeArray[ worker ].bounds = PackRange( first, end );
+			}
+
+			busyCount = unsigned( threadArray.size() );
+			generation++;
+		}
+
+		startCondition.notify_all();
+
+		Work(0);
+
+		std::unique_lock< std::mutex > lock( mutex );
+		while( busyCount > 0 )
+			doneCondition.wait( lock );
+
+		this->job = nullptr;
+		return;
+	}
+#endif
+
+	for( unsigned int i = 0; i < count; i++ )
+		job( 0, i );
+}
+
+#if defined FONTSYS_THREADS
+
+void WorkerPool::ThreadMain( unsigned int worker )
+{
+	unsigned int lastGeneration = 0;
+
+	while( true )
+	{
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			while( !quit && generation == lastGeneration )
+				startCondition.wait( lock );
+
+			if( quit )
+				break;
+
+			lastGeneration = generation;
+		}
+
+		Work( worker );
+
+		std::lock_guard< std::mutex > lock( mutex );
+		if( --busyCount == 0 )
+			doneCondition.notify_all();
+	}
+}
+
+void WorkerPool::Work( unsigned int worker )
+{
+	unsigned int index;
+
+	do
+	{
+		while( TakeIndex( worker, index ) )
+			( *job )( worker, index );
+	}
+	while( StealRange( worker ) );
+}
+
+bool WorkerPool::TakeIndex( unsigned int worker, unsigned int& index )
+{
+	std::atomic< uint64_t >& bounds = rangeArray[ worker ].bounds;
+	uint64_t range = bounds.load();
+
+	while( true )
+	{
+		unsigned int first = unsigned( range >> 32 );
+		unsigned int end = unsigned( range );
+		if( first >= end )
+			return false;
+
+		if( bounds.compare_exchange_weak( range, PackRange( first + 1, end ) ) )
+		{
+			index = first;
+			return true;
+		}
+	}
+}
+
+// Return false if there was nothing left to steal.  Indices in the middle of being stolen are in nobody's share,
+// but then the thief runs them, and the batch isn't over until every worker is done.
+bool WorkerPool::StealRange( unsigned int worker )
+{
+	for( unsigned int i = 1; i < workerCount; i++ )
+	{
+		std::atomic< uint64_t >& bounds = rangeArray[ ( worker + i ) % workerCount ].bounds;
+		uint64_t range = bounds.load();
+
+		while( true )
+		{
+			unsigned int first = unsigned( range >> 32 );
+			unsigned int end = unsigned( range );
+			if( first >= end )
+				break;
+
+			// The back half is taken, or the last index if that's all there is.
+			unsigned int middle = first + ( end - first ) / 2;
+
+			if( bounds.compare_exchange_weak( range, PackRange( first, middle ) ) )
+			{
+				rangeArray[ worker ].bounds = PackRange( middle, end );
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+#endif //FONTSYS_THREADS
+
+// WorkerPool.cpp
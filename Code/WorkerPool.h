@@ -0,0 +1,66 @@
+// WorkerPool.h
+
+#pragma once
+
+#include "FontSystem.h"
+#include <functional>
+
+// Without threads, every job runs on the calling thread.
+#if defined FONTSYS_THREADS
+#	include <thread>
+#	include <condition_variable>
+#endif
+
+// An instance of this class keeps a few threads waiting to help the calling thread through a batch of jobs.
+// Each worker starts on its own share of the indices and takes them one at a time from the front.  A worker
+// that runs out steals the back half of someone else's share, so uneven jobs still balance across the threads,
+// while the workers only contend for the same counters when one of them has run dry.
+class FontSys::WorkerPool
+{
+public:
+
+	// A thread count of zero uses one thread per core.  The calling thread counts as one of them.
+	WorkerPool( unsigned int threadCount = 0 );
+	virtual ~WorkerPool( void );
+
+	// The job is given the worker it runs on, from zero up to the worker count, and the index of the job.
+	typedef std::function< void( unsigned int worker, unsigned int index ) > Job;
+
+	// Call the job once for each index, and return when all calls have returned.  This is not reentrant.
+	void Run( unsigned int count, const Job& job );
+
+	unsigned int GetWorkerCount( void ) { return workerCount; }
+
+private:
+
+	unsigned int workerCount;
+
+#if defined FONTSYS_THREADS
+	// The share of a worker is packed into one word, its first index in the high half and its end in the low half,
+	// so that the owner and thieves can both take from it by compare-and-swap.  Each is padded out to a cache line.
+	struct Range
+	{
+		std::atomic< uint64_t > bounds;
+		char padding[ 64 - sizeof( uint64_t ) ];
+	};
+
+	static uint64_t PackRange( unsigned int first, unsigned int end ) { return( uint64_t( first ) << 32 | end ); }
+
+	void ThreadMain( unsigned int worker );
+	void Work( unsigned int worker );
+	bool TakeIndex( unsigned int worker, unsigned int& index );
+	bool StealRange( unsigned int worker );
+
+	std::vector< std::thread > threadArray;
+	std::mutex mutex;
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+	const Job* job;
+	Range* rangeArray;
+	unsigned int generation;
+	unsigned int busyCount;
+	bool quit;
+#endif
+};
+
+// WorkerPool.h
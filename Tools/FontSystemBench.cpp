@@ -0,0 +1,880 @@
+// FontSystemBench.cpp
+
+// This program times the font system with no window and no GPU, drawing through Mesa's software OpenGL
+// into a pbuffer of a surfaceless EGL display.  The results are printed as JSON, so that runs from different
+// builds can be compared by script.
+//
+//   FontSystemBench [-sdf] [<font file>] [<repeat scale>]
+//
+// Every case is run its usual number of times multiplied by the scale, which defaults to 1.
+//
+// The concurrent measuring cases double as a stress test: many threads measure at once, starting from cold
+// caches, and every result is checked against one made on a single thread.  Any mismatch fails the run.
+
+#include "FontSystem.h"
+#include "TextBuffer.h"
+#include "TextDocument.h"
+#include "RetainedText.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+static const int VIEW_SIZE = 512;
+
+static const char* SHORT_TEXT = "Hello, World!";
+
+static const char* PARAGRAPH_TEXT =
+	"The quick brown fox jumps over the lazy dog while five boxing wizards jump quickly. "
+	"Sphinx of black quartz, judge my vow; pack my box with five dozen liquor jugs. "
+	"How vexingly quick daft zebras jump, and the jay, pig, fox, zebra and my wolves quack! ";
+
+struct Result
+{
+	std::string name;
+	int iterations;
+	size_t charCount;
+	double seconds;
+};
+
+static std::vector< Result > resultArray;
+
+static double GetSeconds( void )
+{
+	return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static bool MakeContext( void )
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = ( PFNEGLGETPLATFORMDISPLAYEXTPROC )eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+	if( getPlatformDisplay )
+		display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr );
+
+	if( display == EGL_NO_DISPLAY )
+		display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+	EGLint major, minor;
+	if( display == EGL_NO_DISPLAY || !eglInitialize( display, &major, &minor ) )
+		return false;
+
+	if( !eglBindAPI( EGL_OPENGL_API ) )
+		return false;
+
+	EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configCount = 0;
+	if( !eglChooseConfig( display, configAttributes, &config, 1, &configCount ) || configCount == 0 )
+		return false;
+
+	EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT, nullptr );
+	if( context == EGL_NO_CONTEXT )
+		return false;
+
+	EGLint surfaceAttributes[] = { EGL_WIDTH, VIEW_SIZE, EGL_HEIGHT, VIEW_SIZE, EGL_NONE };
+	EGLSurface surface = eglCreatePbufferSurface( display, config, surfaceAttributes );
+	if( surface == EGL_NO_SURFACE )
+		return false;
+
+	return eglMakeCurrent( display, surface, surface, context ) == EGL_TRUE;
+}
+
+// One unit is one pixel, with the origin at the top left.
+static void SetupView( void )
+{
+	glViewport( 0, 0, VIEW_SIZE, VIEW_SIZE );
+	glMatrixMode( GL_PROJECTION );
+	glLoadIdentity();
+	glOrtho( 0.0, VIEW_SIZE, -VIEW_SIZE, 0.0, -1.0, 1.0 );
+	glMatrixMode( GL_MODELVIEW );
+	glLoadIdentity();
+	glClearColor( 0.f, 0.f, 0.f, 1.f );
+	glColor3f( 1.f, 1.f, 1.f );
+}
+
+static void SetupSystem( FontSys::System& fontSystem, const std::string& fontDir, const std::string& fontName, FontSys::System::RenderMode renderMode )
+{
+	fontSystem.SetFontBaseDir( fontDir );
+	fontSystem.SetFont( fontName );
+	fontSystem.SetRenderMode( renderMode );
+	fontSystem.SetLineHeight( 16.f );
+	fontSystem.SetBaseLineDelta( -20.f );
+	fontSystem.SetLineWidth( 400.f );
+	fontSystem.SetWordWrap( false );
+	fontSystem.SetJustification( FontSys::System::JUSTIFY_LEFT );
+}
+
+static void AddResult( const char* name, int iterations, size_t charCount, double seconds )
+{
+	Result result;
+	result.name = name;
+	result.iterations = iterations;
+	result.charCount = charCount;
+	result.seconds = seconds;
+	resultArray.push_back( result );
+}
+
+// Time the given number of draws of the text, including the time OpenGL takes to finish them.
+static bool TimeDraw( FontSys::System& fontSystem, const char* name, const std::string& text, bool staticText, int iterations )
+{
+	glClear( GL_COLOR_BUFFER_BIT );
+
+	// The first draw rasterizes glyphs and compiles display lists, which isn't what we're after here.
+	if( !fontSystem.DrawText( 8.f, -8.f, text, staticText ) )
+		return false;
+
+	glFinish();
+
+	double startTime = GetSeconds();
+
+	for( int i = 0; i < iterations; i++ )
+		if( !fontSystem.DrawText( 8.f, -8.f, text, staticText ) )
+			return false;
+
+	glFinish();
+
+	AddResult( name, iterations, text.length(), GetSeconds() - startTime );
+	return true;
+}
+
+// Time draws of retained text, which is built when it's created rather than on the first draw.
+static bool TimeRetained( FontSys::System& fontSystem, const char* name, const std::string& text, int iterations )
+{
+	FontSys::RetainedText* retainedText = fontSystem.CreateText( text );
+	if( !retainedText )
+		return false;
+
+	glClear( GL_COLOR_BUFFER_BIT );
+	glFinish();
+
+	double startTime = GetSeconds();
+
+	bool success = true;
+	for( int i = 0; i < iterations && success; i++ )
+		success = retainedText->Draw( 8.f, -8.f );
+
+	glFinish();
+
+	fontSystem.DestroyText( retainedText );
+
+	if( success )
+		AddResult( name, iterations, text.length(), GetSeconds() - startTime );
+
+	return success;
+}
+
+static bool TimeMeasure( FontSys::System& fontSystem, const char* name, const std::string& text, int iterations )
+{
+	GLfloat length = 0.f;
+	if( !fontSystem.CalcTextLength( text, length ) )
+		return false;
+
+	double startTime = GetSeconds();
+
+	for( int i = 0; i < iterations; i++ )
+		if( !fontSystem.CalcTextLength( text, length ) )
+			return false;
+
+	AddResult( name, iterations, text.length(), GetSeconds() - startTime );
+	return true;
+}
+
+// Wrapped measurement lays out lines under the current settings.
+static bool TimeMeasureWrapped( FontSys::System& fontSystem, const char* name, const std::string& text, int iterations )
+{
+	FontSys::System::TextMetrics textMetrics;
+	if( !fontSystem.MeasureText( text, textMetrics ) )
+		return false;
+
+	double startTime = GetSeconds();
+
+	for( int i = 0; i < iterations; i++ )
+		if( !fontSystem.MeasureText( text, textMetrics ) )
+			return false;
+
+	AddResult( name, iterations, text.length(), GetSeconds() - startTime );
+	return true;
+}
+
+// Time frames of many short labels, each with its own position and color, drawn one by one or batched.
+static bool TimeLabels( FontSys::System& fontSystem, const char* name, bool batched, int labelCount, int iterations )
+{
+	double startTime = 0.0;
+
+	// The first frame rasterizes glyphs, which isn't what we're after here.
+	for( int i = -1; i < iterations; i++ )
+	{
+		if( i == 0 )
+		{
+			glFinish();
+			startTime = GetSeconds();
+		}
+
+		if( batched && !fontSystem.BeginBatch() )
+			return false;
+
+		for( int j = 0; j < labelCount; j++ )
+		{
+			glColor3f( GLfloat( j % 3 ) * 0.5f, GLfloat( j % 5 ) * 0.25f, 1.f );
+			if( !fontSystem.DrawText( GLfloat( ( j % 8 ) * 60 ), -GLfloat( ( j / 8 ) * 20 + 8 ), SHORT_TEXT ) )
+				return false;
+		}
+
+		if( batched && !fontSystem.Flush() )
+			return false;
+	}
+
+	glFinish();
+
+	AddResult( name, iterations, strlen( SHORT_TEXT ) * labelCount, GetSeconds() - startTime );
+	return true;
+}
+
+// Time the measuring of a table's worth of cells, one by one or all at once.  Both ways must agree.
+static bool TimeCells( FontSys::System& fontSystem, const char* name, bool batched, const std::vector< std::string >& cellArray, int iterations )
+{
+	std::vector< GLfloat > lengthArray, referenceArray( cellArray.size() );
+
+	for( unsigned int i = 0; i < cellArray.size(); i++ )
+		if( !fontSystem.CalcTextLength( cellArray[i], referenceArray[i] ) )
+			return false;
+
+	if( !fontSystem.CalcTextLengths( cellArray, lengthArray ) || lengthArray != referenceArray )
+		return false;
+
+	size_t charCount = 0;
+	for( unsigned int i = 0; i < cellArray.size(); i++ )
+		charCount += cellArray[i].length();
+
+	double startTime = GetSeconds();
+
+	for( int i = 0; i < iterations; i++ )
+	{
+		if( batched )
+		{
+			if( !fontSystem.CalcTextLengths( cellArray, lengthArray ) )
+				return false;
+		}
+		else
+		{
+			for( unsigned int j = 0; j < cellArray.size(); j++ )
+				if( !fontSystem.CalcTextLength( cellArray[j], lengthArray[j] ) )
+					return false;
+		}
+	}
+
+	AddResult( name, iterations, charCount, GetSeconds() - startTime );
+	return true;
+}
+
+static bool TimeCellsWrapped( FontSys::System& fontSystem, const char* name, const std::vector< std::string >& cellArray, int iterations )
+{
+	std::vector< FontSys::System::TextMetrics > textMetricsArray;
+	if( !fontSystem.MeasureTexts( cellArray, textMetricsArray ) )
+		return false;
+
+	// Batched measures don't go through the layout cache, but should match those that do.
+	for( unsigned int i = 0; i < cellArray.size(); i++ )
+	{
+		FontSys::System::TextMetrics textMetrics;
+		if( !fontSystem.MeasureText( cellArray[i], textMetrics ) || textMetrics.lineWidthArray != textMetricsArray[i].lineWidthArray ||
+			textMetrics.minY != textMetricsArray[i].minY || textMetrics.maxX != textMetricsArray[i].maxX )
+			return false;
+	}
+
+	size_t charCount = 0;
+	for( unsigned int i = 0; i < cellArray.size(); i++ )
+		charCount += cellArray[i].length();
+
+	double startTime = GetSeconds();
+
+	for( int i = 0; i < iterations; i++ )
+		if( !fontSystem.MeasureTexts( cellArray, textMetricsArray ) )
+			return false;
+
+	AddResult( name, iterations, charCount, GetSeconds() - startTime );
+	return true;
+}
+
+// Time frames of a log that gains a line each frame, drawn whole each time, or kept in a text buffer that only
+// lays out and uploads what's new.
+static bool TimeLogAppend( FontSys::System& fontSystem, const char* name, bool retained, int iterations )
+{
+	FontSys::TextBuffer textBuffer( &fontSystem );
+	std::string text;
+	size_t drawnCount = 0;
+
+	glFinish();
+	double startTime = GetSeconds();
+
+	for( int i = 0; i < iterations; i++ )
+	{
+		char line[128];
+		sprintf( line, "[%05d] The quick brown fox jumps over the lazy dog.\n", i );
+
+		glClear( GL_COLOR_BUFFER_BIT );
+
+		if( retained )
+		{
+			textBuffer.Append( line );
+			if( !textBuffer.Draw( 8.f, -8.f ) )
+				return false;
+		}
+		else
+		{
+			text += line;
+			if( !fontSystem.DrawText( 8.f, -8.f, text ) )
+				return false;
+		}
+
+		drawnCount += retained ? textBuffer.GetText().length() : text.length();
+	}
+
+	glFinish();
+
+	// The text grows, so the count is that of the average frame.
+	AddResult( name, iterations, drawnCount / std::max( iterations, 1 ), GetSeconds() - startTime );
+	return true;
+}
+
+// Time the indexing of a document, and then frames that scroll through it a screenful at a time.
+static bool TimeDocumentScroll( FontSys::System& fontSystem, const std::string& text, int iterations )
+{
+	FontSys::TextDocument textDocument( &fontSystem );
+	textDocument.SetText( text );
+
+	double startTime = GetSeconds();
+
+	if( !textDocument.UpdateIndex() || textDocument.GetLineCount() == 0 )
+		return false;
+
+	AddResult( "index_document", 1, text.length(), GetSeconds() - startTime );
+
+	GLfloat documentHeight = -textDocument.GetLine( textDocument.GetLineCount() - 1 ).baseLine;
+	GLfloat viewHeight = GLfloat( VIEW_SIZE );
+	size_t charCount = 0;
+
+	glFinish();
+	startTime = GetSeconds();
+
+	for( int i = 0; i < iterations; i++ )
+	{
+		GLfloat top = -fmodf( GLfloat( i ) * viewHeight, documentHeight );
+
+		glClear( GL_COLOR_BUFFER_BIT );
+		glPushMatrix();
+		glTranslatef( 8.f, -8.f - top, 0.f );
+
+		bool success = textDocument.Draw( 0.f, top - viewHeight, viewHeight, top );
+
+		glPopMatrix();
+
+		if( !success )
+			return false;
+
+		// The count of characters drawn is taken from the average line.
+		charCount += textDocument.GetLastDrawLineCount() * ( text.length() / textDocument.GetLineCount() );
+	}
+
+	glFinish();
+
+	AddResult( "draw_document_scroll", iterations, charCount / std::max( iterations, 1 ), GetSeconds() - startTime );
+	return true;
+}
+
+static void AppendUtf8( std::string& text, unsigned int charCode )
+{
+	if( charCode < 0x80 )
+		text += char( charCode );
+	else if( charCode < 0x800 )
+	{
+		text += char( 0xC0 | ( charCode >> 6 ) );
+		text += char( 0x80 | ( charCode & 0x3F ) );
+	}
+	else
+	{
+		text += char( 0xE0 | ( charCode >> 12 ) );
+		text += char( 0x80 | ( ( charCode >> 6 ) & 0x3F ) );
+		text += char( 0x80 | ( charCode & 0x3F ) );
+	}
+}
+
+// The texts cover several scripts, so that the glyph and kerning tables have to grow while other threads read them.
+static void MakeConcurrentTexts( std::vector< std::string >& textArray )
+{
+	static const unsigned int rangeArray[][2] = { { 0x20, 0x7F }, { 0xA0, 0x180 }, { 0x370, 0x400 }, { 0x400, 0x500 } };
+
+	textArray.clear();
+	textArray.push_back( PARAGRAPH_TEXT );
+
+	for( unsigned int i = 0; i < sizeof( rangeArray ) / sizeof( rangeArray[0] ); i++ )
+	{
+		std::string text;
+		for( unsigned int charCode = rangeArray[i][0]; charCode < rangeArray[i][1]; charCode++ )
+		{
+			AppendUtf8( text, charCode );
+			if( charCode % 7 == 0 )
+				text += ' ';
+		}
+
+		textArray.push_back( text );
+		textArray.push_back( text + PARAGRAPH_TEXT );
+	}
+}
+
+// Noncharacters are never in a font, so each is drawn as a solid box.  A fresh system is used for each way of drawing,
+// so that the boxes come before any glyph image has given the strike a page.
+static bool CheckMissingGlyphs( const std::string& fontDir, const std::string& fontName, FontSys::System::RenderMode renderMode )
+{
+	std::string text;
+	for( unsigned int charCode = 0xFDD0; charCode < 0xFDD8; charCode++ )
+		AppendUtf8( text, charCode );
+
+	for( int batched = 0; batched < 2; batched++ )
+	{
+		FontSys::System fontSystem;
+		SetupSystem( fontSystem, fontDir, fontName, renderMode );
+		if( !fontSystem.Initialize() )
+			return false;
+
+		glClear( GL_COLOR_BUFFER_BIT );
+
+		if( batched && !fontSystem.BeginBatch() )
+			return false;
+
+		if( !fontSystem.DrawText( 8.f, -24.f, text ) )
+			return false;
+
+		if( batched && !fontSystem.Flush() )
+			return false;
+
+		std::vector< GLubyte > pixelArray( VIEW_SIZE * VIEW_SIZE * 4 );
+		glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+		glReadPixels( 0, 0, VIEW_SIZE, VIEW_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, &pixelArray[0] );
+
+		fontSystem.Finalize();
+
+		unsigned int coverage = 0;
+		for( size_t j = 0; j < pixelArray.size(); j += 4 )
+			coverage += pixelArray[j];
+
+		if( coverage == 0 )
+		{
+			fprintf( stderr, "text of only missing glyphs drew nothing%s\n", batched ? " in a batch" : "" );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool MetricsMatch( const FontSys::System::TextMetrics& metricsA, const FontSys::System::TextMetrics& metricsB )
+{
+	return( metricsA.lineCount == metricsB.lineCount && metricsA.lineWidthArray == metricsB.lineWidthArray &&
+			metricsA.minX == metricsB.minX && metricsA.minY == metricsB.minY &&
+			metricsA.maxX == metricsB.maxX && metricsA.maxY == metricsB.maxY );
+}
+
+// Measure every text on each of the given number of threads at once, from a fresh system, checking each result
+// against the reference.  Threads start at different texts so that they run into each other's cache misses.
+static bool TimeConcurrentMeasure( const std::string& fontDir, const std::string& fontName, FontSys::System::RenderMode renderMode,
+									const char* name, unsigned int threadCount, int passCount, const std::vector< std::string >& textArray,
+									const FontSys::System::LayoutParams& params, const std::vector< FontSys::System::TextMetrics >& referenceArray,
+									unsigned int& mismatchCount )
+{
+	FontSys::System fontSystem;
+	SetupSystem( fontSystem, fontDir, fontName, renderMode );
+	if( !fontSystem.Initialize() )
+		return false;
+
+	std::atomic< bool > go( false );
+	std::atomic< unsigned int > failureCount( 0 ), mismatches( 0 );
+	std::vector< std::thread > threadArray;
+
+	for( unsigned int i = 0; i < threadCount; i++ )
+	{
+		threadArray.push_back( std::thread( [&, i]()
+		{
+			while( !go.load() )
+				std::this_thread::yield();
+
+			FontSys::System::TextMetrics textMetrics;
+
+			for( int pass = 0; pass < passCount; pass++ )
+			{
+				for( unsigned int j = 0; j < textArray.size(); j++ )
+				{
+					unsigned int k = ( i + j ) % textArray.size();
+
+					if( !fontSystem.MeasureText( fontName, params, textArray[k], textMetrics ) )
+						failureCount++;
+					else if( !MetricsMatch( textMetrics, referenceArray[k] ) )
+						mismatches++;
+				}
+			}
+		} ) );
+	}
+
+	double startTime = GetSeconds();
+	go = true;
+
+	for( unsigned int i = 0; i < threadArray.size(); i++ )
+		threadArray[i].join();
+
+	double seconds = GetSeconds() - startTime;
+
+	fontSystem.Finalize();
+
+	size_t charCount = 0;
+	for( unsigned int i = 0; i < textArray.size(); i++ )
+		charCount += textArray[i].length();
+
+	AddResult( name, int( threadCount ) * passCount, charCount, seconds );
+
+	mismatchCount += mismatches;
+	return( failureCount == 0 );
+}
+
+static void PrintString( const std::string& string )
+{
+	putchar( '"' );
+	for( size_t i = 0; i < string.length(); i++ )
+	{
+		char ch = string[i];
+		if( ch == '"' || ch == '\\' )
+			printf( "\\%c", ch );
+		else if( ( unsigned char )ch < 0x20 )
+			printf( "\\u%04x", ch );
+		else
+			putchar( ch );
+	}
+	putchar( '"' );
+}
+
+int main( int argc, char** argv )
+{
+	FontSys::System::RenderMode renderMode = FontSys::System::RENDER_COVERAGE;
+	std::string fontPath = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+	int scale = 1;
+
+	int i = 1;
+	if( i < argc && strcmp( argv[i], "-sdf" ) == 0 )
+	{
+		renderMode = FontSys::System::RENDER_DISTANCE_FIELD;
+		i++;
+	}
+
+	if( i < argc )
+		fontPath = argv[ i++ ];
+
+	if( i < argc )
+		scale = atoi( argv[ i++ ] );
+
+	if( i < argc || scale < 1 )
+	{
+		fprintf( stderr, "usage: %s [-sdf] [<font file>] [<repeat scale>]\n", argv[0] );
+		return 1;
+	}
+
+	// The system finds fonts by directory and name.
+	std::string fontDir = ".";
+	std::string fontName = fontPath;
+	size_t slash = fontPath.find_last_of( "/\\" );
+	if( slash != std::string::npos )
+	{
+		fontDir = fontPath.substr( 0, slash );
+		fontName = fontPath.substr( slash + 1 );
+	}
+
+	if( !MakeContext() )
+	{
+		fprintf( stderr, "failed to create a headless OpenGL context\n" );
+		return 1;
+	}
+
+	SetupView();
+
+	std::string longText;
+	for( int j = 0; j < 8; j++ )
+		longText += PARAGRAPH_TEXT;
+
+	// A document is a megabyte of paragraphs.
+	std::string documentText;
+	while( documentText.length() < 1024 * 1024 )
+	{
+		documentText += PARAGRAPH_TEXT;
+		documentText += '\n';
+	}
+
+	std::string printableText;
+	for( char ch = 0x20; ch < 0x7F; ch++ )
+		printableText += ch;
+
+	bool success = false;
+	const char* failedCase = "";
+	size_t textureBytes = 0;
+	FontSys::System::Stats stats;
+	unsigned int concurrentThreadCount = std::max( 4u, std::thread::hardware_concurrency() );
+	unsigned int mismatchCount = 0;
+
+	do
+	{
+		// Loading a font is timed from a fresh system to the first measurement, which opens the face
+		// but needs no glyph images.  The first draw then rasterizes and uploads them.
+		int loadIterations = 20 * scale;
+		double loadSeconds = 0.0, firstDrawSeconds = 0.0;
+
+		int j;
+		for( j = 0; j < loadIterations; j++ )
+		{
+			FontSys::System fontSystem;
+			SetupSystem( fontSystem, fontDir, fontName, renderMode );
+
+			double startTime = GetSeconds();
+
+			GLfloat length = 0.f;
+			if( !fontSystem.Initialize() || !fontSystem.CalcTextLength( SHORT_TEXT, length ) )
+				break;
+
+			double loadTime = GetSeconds();
+
+			if( !fontSystem.DrawText( 8.f, -8.f, printableText ) )
+				break;
+
+			glFinish();
+
+			loadSeconds += loadTime - startTime;
+			firstDrawSeconds += GetSeconds() - loadTime;
+
+			fontSystem.Finalize();
+		}
+
+		if( j < loadIterations )
+		{
+			failedCase = "font_load";
+			break;
+		}
+
+		AddResult( "font_load", loadIterations, 0, loadSeconds );
+		AddResult( "first_draw", loadIterations, printableText.length(), firstDrawSeconds );
+
+		if( !CheckMissingGlyphs( fontDir, fontName, renderMode ) )
+		{
+			failedCase = "draw_missing_glyphs";
+			break;
+		}
+
+		FontSys::System fontSystem;
+		SetupSystem( fontSystem, fontDir, fontName, renderMode );
+		if( !fontSystem.Initialize() )
+		{
+			failedCase = "initialize";
+			break;
+		}
+
+		if( !TimeMeasure( fontSystem, "measure_short", SHORT_TEXT, 20000 * scale ) ||
+			!TimeMeasure( fontSystem, "measure_long", longText, 200 * scale ) )
+		{
+			failedCase = "measure";
+			break;
+		}
+
+		if( !TimeDraw( fontSystem, "draw_dynamic_short", SHORT_TEXT, false, 5000 * scale ) ||
+			!TimeDraw( fontSystem, "draw_dynamic_long", longText, false, 100 * scale ) ||
+			!TimeDraw( fontSystem, "draw_static_short", SHORT_TEXT, true, 5000 * scale ) ||
+			!TimeDraw( fontSystem, "draw_static_long", longText, true, 100 * scale ) ||
+			!TimeRetained( fontSystem, "draw_retained_short", SHORT_TEXT, 5000 * scale ) ||
+			!TimeRetained( fontSystem, "draw_retained_long", longText, 100 * scale ) )
+		{
+			failedCase = "draw";
+			break;
+		}
+
+		// The cells of a table are mostly short, with the odd long one.
+		std::vector< std::string > cellArray;
+		for( j = 0; j < 2000; j++ )
+		{
+			char cell[64];
+			sprintf( cell, "Row %d, column %d", j / 8, j % 8 );
+			cellArray.push_back( j % 50 == 0 ? std::string( cell ) + " " + PARAGRAPH_TEXT : std::string( cell ) );
+		}
+
+		if( !TimeCells( fontSystem, "measure_cells_serial", false, cellArray, 20 * scale ) ||
+			!TimeCells( fontSystem, "measure_cells_batched", true, cellArray, 20 * scale ) )
+		{
+			failedCase = "measure_cells";
+			break;
+		}
+
+		fontSystem.SetWordWrap( true );
+
+		if( !TimeCellsWrapped( fontSystem, "measure_cells_wrapped_batched", cellArray, 20 * scale ) )
+		{
+			failedCase = "measure_cells_wrapped";
+			break;
+		}
+
+		if( !TimeMeasureWrapped( fontSystem, "measure_wrapped", longText, 200 * scale ) ||
+			!TimeMeasureWrapped( fontSystem, "measure_wrapped_document", documentText, 5 * scale ) )
+		{
+			failedCase = "measure_wrapped";
+			break;
+		}
+
+		if( !TimeDraw( fontSystem, "draw_wrapped", longText, false, 100 * scale ) )
+		{
+			failedCase = "draw_wrapped";
+			break;
+		}
+
+		if( !TimeDocumentScroll( fontSystem, documentText, 100 * scale ) )
+		{
+			failedCase = "draw_document_scroll";
+			break;
+		}
+
+		if( !TimeLogAppend( fontSystem, "draw_log_append_whole", false, 200 * scale ) ||
+			!TimeLogAppend( fontSystem, "draw_log_append_retained", true, 200 * scale ) )
+		{
+			failedCase = "draw_log_append";
+			break;
+		}
+
+		fontSystem.SetJustification( FontSys::System::JUSTIFY_LEFT_AND_RIGHT );
+
+		if( !TimeDraw( fontSystem, "draw_justified", longText, false, 100 * scale ) )
+		{
+			failedCase = "draw_justified";
+			break;
+		}
+
+		fontSystem.SetWordWrap( false );
+		fontSystem.SetJustification( FontSys::System::JUSTIFY_LEFT );
+
+		if( !TimeLabels( fontSystem, "draw_labels_immediate", false, 200, 50 * scale ) ||
+			!TimeLabels( fontSystem, "draw_labels_batched", true, 200, 50 * scale ) )
+		{
+			failedCase = "draw_labels";
+			break;
+		}
+
+		FontSys::FontByteCountMap fontByteCountMap;
+		textureBytes = fontSystem.GetTextureMemoryUsage( fontByteCountMap );
+
+		FontSys::System::FontStatsMap fontStatsMap;
+		fontSystem.GetStats( stats, fontStatsMap );
+
+		fontSystem.Finalize();
+
+		std::vector< std::string > concurrentTextArray;
+		MakeConcurrentTexts( concurrentTextArray );
+
+		FontSys::System::LayoutParams params;
+		params.lineWidth = 300.f;
+		params.lineHeight = 16.f;
+		params.baseLineDelta = -20.f;
+		params.justification = FontSys::System::JUSTIFY_LEFT_AND_RIGHT;
+		params.wordWrap = true;
+
+		// The reference is made on this thread alone.
+		std::vector< FontSys::System::TextMetrics > referenceArray( concurrentTextArray.size() );
+		{
+			FontSys::System referenceSystem;
+			SetupSystem( referenceSystem, fontDir, fontName, renderMode );
+			if( !referenceSystem.Initialize() )
+			{
+				failedCase = "measure_concurrent";
+				break;
+			}
+
+			for( j = 0; j < int( concurrentTextArray.size() ); j++ )
+				if( !referenceSystem.MeasureText( fontName, params, concurrentTextArray[j], referenceArray[j] ) )
+					break;
+
+			referenceSystem.Finalize();
+
+			if( j < int( concurrentTextArray.size() ) )
+			{
+				failedCase = "measure_concurrent";
+				break;
+			}
+		}
+
+		if( !TimeConcurrentMeasure( fontDir, fontName, renderMode, "measure_concurrent_1", 1, 20 * scale, concurrentTextArray, params, referenceArray, mismatchCount ) ||
+			!TimeConcurrentMeasure( fontDir, fontName, renderMode, "measure_concurrent_n", concurrentThreadCount, 20 * scale, concurrentTextArray, params, referenceArray, mismatchCount ) )
+		{
+			failedCase = "measure_concurrent";
+			break;
+		}
+
+		if( mismatchCount > 0 )
+		{
+			fprintf( stderr, "%u concurrent measurements differed from the reference\n", mismatchCount );
+			failedCase = "measure_concurrent";
+			break;
+		}
+
+		success = true;
+	}
+	while( false );
+
+	if( !success )
+	{
+		fprintf( stderr, "the %s case failed\n", failedCase );
+		return 1;
+	}
+
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+
+	printf( "{\n" );
+	printf( "\t\"renderer\": " );
+	PrintString( ( const char* )glGetString( GL_RENDERER ) );
+	printf( ",\n\t\"font\": " );
+	PrintString( fontPath );
+	printf( ",\n\t\"render_mode\": \"%s\",\n", renderMode == FontSys::System::RENDER_DISTANCE_FIELD ? "sdf" : "coverage" );
+	printf( "\t\"cases\": [\n" );
+
+	for( size_t j = 0; j < resultArray.size(); j++ )
+	{
+		const Result& result = resultArray[j];
+		double microseconds = result.seconds * 1e6 / double( result.iterations );
+		double charsPerSecond = result.seconds > 0.0 ? double( result.charCount ) * double( result.iterations ) / result.seconds : 0.0;
+
+		printf( "\t\t{ \"name\": \"%s\", \"iterations\": %d, \"total_ms\": %.3f, \"us_per_iteration\": %.3f, \"chars_per_second\": %.0f }%s\n",
+				result.name.c_str(), result.iterations, result.seconds * 1e3, microseconds, charsPerSecond,
+				j + 1 < resultArray.size() ? "," : "" );
+	}
+
+	printf( "\t],\n" );
+	printf( "\t\"stats\": { \"glyph_cache_hits\": %llu, \"glyph_cache_misses\": %llu, \"kerning_lookups\": %llu, \"kerning_cache_misses\": %llu, "
+			"\"glyphs_rasterized\": %llu, \"texture_binds\": %llu, \"draw_calls\": %llu, \"display_list_calls\": %llu, "
+			"\"layout_count\": %llu, \"layout_ms\": %.3f, \"display_list_count\": %u },\n",
+			( unsigned long long )stats.glyphCacheHits, ( unsigned long long )stats.glyphCacheMisses,
+			( unsigned long long )stats.kerningLookups, ( unsigned long long )stats.kerningCacheMisses,
+			( unsigned long long )stats.glyphsRasterized, ( unsigned long long )stats.textureBinds, ( unsigned long long )stats.drawCalls,
+			( unsigned long long )stats.displayListCalls, ( unsigned long long )stats.layoutCount, stats.layoutSeconds * 1e3,
+			unsigned( stats.displayListCount ) );
+	// Scaling is the throughput on all threads over that on one, which ideally is the thread count, given as many cores.
+	const Result& singleResult = resultArray[ resultArray.size() - 2 ];
+	const Result& multipleResult = resultArray[ resultArray.size() - 1 ];
+	double scaling = ( double( multipleResult.iterations ) / multipleResult.seconds ) / ( double( singleResult.iterations ) / singleResult.seconds );
+
+	printf( "\t\"concurrency\": { \"threads\": %u, \"cores\": %u, \"mismatches\": %u, \"scaling\": %.2f },\n",
+			concurrentThreadCount, std::thread::hardware_concurrency(), mismatchCount, scaling );
+	printf( "\t\"texture_bytes\": %u,\n", unsigned( textureBytes ) );
+	printf( "\t\"peak_rss_kb\": %ld\n", long( usage.ru_maxrss ) );
+	printf( "}\n" );
+
+	return 0;
+}
+
+// FontSystemBench.cpp
@@ -0,0 +1,96 @@
+// GlyphCacheBake.cpp
+
+// This tool bakes glyph caches for a font file ahead of time, so that they can be shipped alongside it.
+//
+//   GlyphCacheBake [-sdf] <font file> <cache dir> [<first>-<last> ...]
+//
+// Character ranges are given in hexadecimal.  Without any, printable ASCII and Latin-1 are baked.
+
+#include "FontSystem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main( int argc, char** argv )
+{
+	FontSys::System::RenderMode renderMode = FontSys::System::RENDER_COVERAGE;
+
+	int i = 1;
+	if( i < argc && strcmp( argv[i], "-sdf" ) == 0 )
+	{
+		renderMode = FontSys::System::RENDER_DISTANCE_FIELD;
+		i++;
+	}
+
+	if( argc - i < 2 )
+	{
+		fprintf( stderr, "usage: %s [-sdf] <font file> <cache dir> [<first>-<last> ...]\n", argv[0] );
+		return 1;
+	}
+
+	std::string fontPath = argv[ i++ ];
+	std::string cacheDir = argv[ i++ ];
+
+	FontSys::CharCodeArray charCodeArray;
+
+	for( ; i < argc; i++ )
+	{
+		char* end = nullptr;
+		unsigned long first = strtoul( argv[i], &end, 16 );
+		unsigned long last = first;
+		if( *end == '-' )
+			last = strtoul( end + 1, &end, 16 );
+
+		if( *end != '\0' || last < first )
+		{
+			fprintf( stderr, "bad character range: %s\n", argv[i] );
+			return 1;
+		}
+
+		for( unsigned long charCode = first; charCode <= last; charCode++ )
+			charCodeArray.push_back( charCode );
+	}
+
+	if( charCodeArray.size() == 0 )
+	{
+		for( unsigned long charCode = 0x20; charCode <= 0xFF; charCode++ )
+			if( charCode < 0x7F || charCode >= 0xA0 )
+				charCodeArray.push_back( charCode );
+	}
+
+	// The system finds fonts by directory and name.
+	std::string fontDir = ".";
+	std::string fontName = fontPath;
+	size_t slash = fontPath.find_last_of( "/\\" );
+	if( slash != std::string::npos )
+	{
+		fontDir = fontPath.substr( 0, slash );
+		fontName = fontPath.substr( slash + 1 );
+	}
+
+	FontSys::System fontSystem;
+	if( !fontSystem.Initialize() )
+	{
+		fprintf( stderr, "failed to initialize FreeType\n" );
+		return 1;
+	}
+
+	fontSystem.SetFontBaseDir( fontDir );
+	fontSystem.SetFont( fontName );
+	fontSystem.SetRenderMode( renderMode );
+	fontSystem.SetGlyphCacheDir( cacheDir );
+
+	if( !fontSystem.BakeGlyphCache( charCodeArray ) )
+	{
+		fprintf( stderr, "failed to bake %s into %s\n", fontPath.c_str(), cacheDir.c_str() );
+		return 1;
+	}
+
+	printf( "baked %u characters of %s into %s\n", unsigned( charCodeArray.size() ), fontPath.c_str(), cacheDir.c_str() );
+
+	fontSystem.Finalize();
+
+	return 0;
+}
+
+// GlyphCacheBake.cpp